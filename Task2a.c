@@ -22,21 +22,52 @@
 **********************************************
 
 */
-// Platform-specific includes for Windows compatibility
-#ifdef _WIN32
-    #define WINVER 0x0600
-    #define _WIN32_WINNT 0x0600
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-#endif
-
 #include "coppeliasim_client.h"  // Include our header
+#include "telemetry.h"
+#include "clock_util.h"
+#include "sensor_kernels.h"
+#include "lifecycle.h"
+#include "rt_thread.h"
+#include "adaptive_rate.h"
+#include "state_estimator.h"
+#include "motion_profile.h"
+#include "line_recovery.h"
+#include "fault_injection.h"
+#include "metrics.h"
 #include <sys/time.h>
 #include <math.h>
 #include <string.h>
+#include <errno.h>
+
+// Per-tick log lines on stdout; state transitions are always printed
+#ifndef TICK_LOG
+#define TICK_LOG 1
+#endif
+
+#if TICK_LOG
+#define tick_log(...) printf(__VA_ARGS__)
+#else
+#define tick_log(...) ((void)0)
+#endif
 
 // Global client instance for socket communication
-SocketClient client;
+SocketClient* client;
+
+// Per-tick telemetry, exported on shutdown
+#define TELEMETRY_FILE "task2a_telemetry.cbt"
+TelemetryStore telemetry;
+
+// Optional input/output recordings, enabled by setting CB_RECORDING to a base path
+Recorder input_recording;
+Recorder output_recording;
+
+// Stale-data failsafe, configured by CB_FRAME_PERIOD_MS / CB_LATENCY_BUDGET_MS
+Watchdog watchdog;
+
+// Optional real-time setup (CB_RT_CONTROL_* / CB_RT_RECEIVE_*) and control period statistics
+RtThreadConfig control_rt;
+RtThreadConfig receive_rt;
+RtCycleTimer control_timer;
 
 // Robot state management
 typedef enum {
@@ -49,20 +80,14 @@ typedef enum {
     STATE_DROPPING       // Dropping the box in correct zone
 } RobotState;
 
-// Color detection thresholds
-#define RED_THRESHOLD_R    0.7
-#define RED_THRESHOLD_G    0.3
-#define RED_THRESHOLD_B    0.3
-#define GREEN_THRESHOLD_R  0.3
-#define GREEN_THRESHOLD_G  0.7
-#define GREEN_THRESHOLD_B  0.3
-#define BLUE_THRESHOLD_R   0.3
-#define BLUE_THRESHOLD_G   0.3
-#define BLUE_THRESHOLD_B   0.7
+// Color and line thresholds live in sensor_kernels.h, shared with the batch kernels
 
 // Proximity thresholds
 #define BOX_DETECTION_DISTANCE 0.5  // meters
 #define CLOSE_DISTANCE 0.2          // meters
+#define MIN_VALID_DISTANCE 0.1      // meters; closer readings do not count as a detection
+#define DISTANCE_CONFIDENCE 2.0f    // Sigmas the filtered distance must clear a threshold by
+#define PICK_DISTANCE 0.17f         // meters; the approach decelerates into this pose
 
 // Motor speeds
 #define BASE_SPEED 0.3
@@ -72,13 +97,53 @@ typedef enum {
 RobotState current_state = STATE_SEARCHING;
 bool has_box = false;
 char detected_color = 'N'; // 'R', 'G', 'B', or 'N' for none
-int state_counter = 0; // Counter for state transitions
+int drop_navigation_ms = 0; // Control time spent navigating to the drop zone
 bool at_node_n1 = false; // Flag to track if robot is at Node N1
+RobotState recorded_state = STATE_SEARCHING; // Last state indexed in the output recording
+
+// Control tick periods: default per state, near junctions, while stationary, and while retrying
+#define CONTROL_PERIOD_MS 50
+#define FAST_PERIOD_MS 20
+#define IDLE_PERIOD_MS 100
+#define AT_NODE_PERIOD_MS 100
+#define RETRY_PERIOD_MS 100
+
+// Drive towards the drop zone for this long before dropping
+#define DROP_NAVIGATION_MS 2500
+
+// Adaptive tick period (CB_RATE_* overrides, see adaptive_rate.h)
+AdaptiveRate control_rate;
+double control_time = 0;       // Sum of tick periods so far, seconds
+int last_period_ms = CONTROL_PERIOD_MS;
+// Filtered distance to the box and line offset (see state_estimator.h)
+StateEstimator estimator;
+unsigned long box_lost_events = 0;  // APPROACHING -> SEARCHING transitions
+
+// Speed profile of the final approach (see motion_profile.h)
+ApproachProfile approach;
+
+// Memory-guided search for a lost line (see line_recovery.h)
+LineRecovery line_recovery;
+
+// Live counters, served on CB_METRICS_SOCKET when set (see metrics.h)
+ControlMetrics metrics;
+MetricsServer metrics_server;
+
+// PICK / DROP in progress (0 = none); the state machine polls it every tick
+ActionId arm_action = 0;
+bool action_acks = false;      // CB_ACTION_ACKS: the server acknowledges PICK/DROP
+
+static const char* const state_names[] = {"SEARCHING", "APPROACHING", "PICKING", "NAVIGATING_TO_NODE",
+                                          "AT_NODE", "NAVIGATING_TO_DROP", "DROPPING"};
 
 // ----------------------
 // Forward declarations
 // ----------------------
 void* control_loop(void* arg);
+void init_controller(void);
+int controller_state(void);
+const char* controller_state_name(int state);
+int control_step(SocketClient* c);
 char detect_color(SocketClient* c);
 void follow_line(SocketClient* c);
 void search_for_box(SocketClient* c);
@@ -86,55 +151,6 @@ void navigate_to_drop_zone(SocketClient* c, char color);
 bool detect_node_n1(SocketClient* c);
 void navigate_to_specific_drop_zone(SocketClient* c, char color);
 
-/**
- * @brief Establishes connection to the CoppeliaSim server
- */
-int connect_to_server(SocketClient* c, const char* ip, int port) {
-#ifdef _WIN32
-    // Initialize Winsock on Windows
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
-        printf("WSAStartup failed\n");
-        return 0;
-    }
-#endif
-    
-    // Create TCP socket
-    c->sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (c->sock < 0) {
-        printf("Socket creation failed\n");
-        return 0;
-    }
-
-    // Setup server address structure
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-    inet_pton(AF_INET, ip, &serv_addr.sin_addr);
-
-    // Attempt to connect to server
-    if (connect(c->sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        printf("Connection failed\n");
-        CLOSESOCKET(c->sock);
-#ifdef _WIN32
-        WSACleanup();
-#endif
-        return 0;
-    }
-
-    c->running = true;
-
-    // Start the receive thread to handle incoming sensor data
-#ifdef _WIN32
-    c->recv_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)receive_loop, c, 0, NULL);
-#else
-    pthread_create(&c->recv_thread, NULL, receive_loop, c);
-#endif
-
-    return 1;
-}
-
 /**
  * @brief Get current time in seconds
  */
@@ -150,24 +166,8 @@ double get_current_time() {
  * @return 'R' for red, 'G' for green, 'B' for blue, 'N' for none
  */
 char detect_color(SocketClient* c) {
-    float r = c->color_r;
-    float g = c->color_g;
-    float b = c->color_b;
-    
-    // Check for red color
-    if (r > RED_THRESHOLD_R && g < RED_THRESHOLD_G && b < RED_THRESHOLD_B) {
-        return 'R';
-    }
-    // Check for green color
-    else if (r < GREEN_THRESHOLD_R && g > GREEN_THRESHOLD_G && b < GREEN_THRESHOLD_B) {
-        return 'G';
-    }
-    // Check for blue color
-    else if (r < BLUE_THRESHOLD_R && g < BLUE_THRESHOLD_G && b > BLUE_THRESHOLD_B) {
-        return 'B';
-    }
-    
-    return 'N'; // No color detected
+    const ClientSnapshot* s = client_snapshot(c);
+    return classify_color(s->color_r, s->color_g, s->color_b);
 }
 
 /**
@@ -175,51 +175,46 @@ char detect_color(SocketClient* c) {
  * @param c Pointer to SocketClient structure
  */
 void follow_line(SocketClient* c) {
-    float ir1 = c->line_sensors[0];  // left_corner
-    float ir2 = c->line_sensors[1];  // left
-    float ir3 = c->line_sensors[2];  // middle
-    float ir4 = c->line_sensors[3];  // right
-    float ir5 = c->line_sensors[4];  // right_corner
-    
-    // Calculate error based on line sensor readings
-    // Lower values indicate line detected
-    float left_error = (ir1 + ir2) / 2.0;   // Average of left sensors
-    float right_error = (ir4 + ir5) / 2.0;  // Average of right sensors
-    float center_error = ir3;               // Center sensor
-    
     float left_speed = BASE_SPEED;
     float right_speed = BASE_SPEED;
     
     // Enhanced line following with better error handling
-    if (center_error < 0.4) {
-        // Line detected in center, go straight
-        left_speed = BASE_SPEED;
-        right_speed = BASE_SPEED;
-        printf("Following line - straight\n");
-    }
-    else if (left_error < 0.4 && right_error > 0.6) {
-        // Line detected on left side, turn left
-        left_speed = BASE_SPEED - TURN_SPEED;
-        right_speed = BASE_SPEED + TURN_SPEED;
-        printf("Following line - turning left\n");
-    }
-    else if (right_error < 0.4 && left_error > 0.6) {
-        // Line detected on right side, turn right
-        left_speed = BASE_SPEED + TURN_SPEED;
-        right_speed = BASE_SPEED - TURN_SPEED;
-        printf("Following line - turning right\n");
-    }
-    else if (left_error < 0.4 && right_error < 0.4) {
-        // Line detected on both sides (intersection), go straight
-        left_speed = BASE_SPEED;
-        right_speed = BASE_SPEED;
-        printf("Following line - intersection, going straight\n");
-    }
-    else {
-        // No line detected, search by turning
-        left_speed = TURN_SPEED;
-        right_speed = -TURN_SPEED;
-        printf("No line detected - searching\n");
+    switch (classify_line(client_line_sensors(c))) {
+        case LINE_STRAIGHT:
+            // Line detected in center, go straight
+            left_speed = BASE_SPEED;
+            right_speed = BASE_SPEED;
+            tick_log("Following line - straight\n");
+            break;
+        case LINE_LEFT:
+            // Line detected on left side, turn left
+            left_speed = BASE_SPEED - TURN_SPEED;
+            right_speed = BASE_SPEED + TURN_SPEED;
+            tick_log("Following line - turning left\n");
+            break;
+        case LINE_RIGHT:
+            // Line detected on right side, turn right
+            left_speed = BASE_SPEED + TURN_SPEED;
+            right_speed = BASE_SPEED - TURN_SPEED;
+            tick_log("Following line - turning right\n");
+            break;
+        case LINE_INTERSECTION:
+            // Line detected on both sides (intersection), go straight
+            left_speed = BASE_SPEED;
+            right_speed = BASE_SPEED;
+            tick_log("Following line - intersection, going straight\n");
+            break;
+        default: {
+            // No line detected, search towards where it was last seen
+            unsigned long failures = line_recovery.failures;
+            line_recovery_steer(&line_recovery, control_time, BASE_SPEED, TURN_SPEED, &left_speed, &right_speed);
+            if (line_recovery.failures != failures) {
+                printf("Line not found after %.1f s, spiralling outwards to find it\n", line_recovery.timeout_s);
+            }
+            tick_log("No line detected - searching %s (stage %d)\n", line_recovery.side > 0 ? "right" : "left",
+                     line_recovery.stage);
+            break;
+        }
     }
     
     set_motor(c, left_speed, right_speed);
@@ -243,19 +238,9 @@ bool detect_node_n1(SocketClient* c) {
     // This is a simplified detection based on line sensor patterns
     // In a real implementation, you might use specific markers or coordinates
     
-    float ir1 = c->line_sensors[0];  // left_corner
-    float ir2 = c->line_sensors[1];  // left
-    float ir3 = c->line_sensors[2];  // middle
-    float ir4 = c->line_sensors[3];  // right
-    float ir5 = c->line_sensors[4];  // right_corner
-    
     // Node N1 detection: multiple lines detected (intersection)
     // All sensors detecting lines indicates an intersection
-    if (ir1 < 0.4 && ir2 < 0.4 && ir3 < 0.4 && ir4 < 0.4 && ir5 < 0.4) {
-        return true;
-    }
-    
-    return false;
+    return is_node_pattern(client_line_sensors(c));
 }
 
 /**
@@ -271,22 +256,22 @@ void navigate_to_drop_zone(SocketClient* c, char color) {
     switch (color) {
         case 'R':
             // Navigate to red drop zone
-            printf("Navigating to RED drop zone...\n");
+            tick_log("Navigating to RED drop zone...\n");
             follow_line(c);
             break;
         case 'G':
             // Navigate to green drop zone
-            printf("Navigating to GREEN drop zone...\n");
+            tick_log("Navigating to GREEN drop zone...\n");
             follow_line(c);
             break;
         case 'B':
             // Navigate to blue drop zone
-            printf("Navigating to BLUE drop zone...\n");
+            tick_log("Navigating to BLUE drop zone...\n");
             follow_line(c);
             break;
         default:
             // Unknown color, just follow line
-            printf("Unknown color, following line...\n");
+            tick_log("Unknown color, following line...\n");
             follow_line(c);
             break;
     }
@@ -304,25 +289,25 @@ void navigate_to_specific_drop_zone(SocketClient* c, char color) {
     switch (color) {
         case 'R':
             // Navigate to red drop zone (top)
-            printf("Navigating to RED drop zone (top)...\n");
+            tick_log("Navigating to RED drop zone (top)...\n");
             // Turn right and follow line to red zone
             set_motor(c, TURN_SPEED, -TURN_SPEED);
             break;
         case 'G':
             // Navigate to green drop zone (bottom)
-            printf("Navigating to GREEN drop zone (bottom)...\n");
+            tick_log("Navigating to GREEN drop zone (bottom)...\n");
             // Turn left and follow line to green zone
             set_motor(c, -TURN_SPEED, TURN_SPEED);
             break;
         case 'B':
             // Navigate to blue drop zone (middle)
-            printf("Navigating to BLUE drop zone (middle)...\n");
+            tick_log("Navigating to BLUE drop zone (middle)...\n");
             // Go straight to blue zone
             follow_line(c);
             break;
         default:
             // Unknown color, just follow line
-            printf("Unknown color, following line...\n");
+            tick_log("Unknown color, following line...\n");
             follow_line(c);
             break;
     }
@@ -330,237 +315,456 @@ void navigate_to_specific_drop_zone(SocketClient* c, char color) {
 
 
 /**
- * @brief Main control loop thread for robot behavior
+ * @brief Resets the state machine and configures the per-state tick periods;
+ *        call before the first control_step
  */
-void* control_loop(void* arg) {
-    SocketClient* c = (SocketClient*)arg;
+void init_controller(void) {
+    current_state = STATE_SEARCHING;
+    recorded_state = STATE_SEARCHING;
+    has_box = false;
+    detected_color = 'N';
+    drop_navigation_ms = 0;
+    at_node_n1 = false;
+    arm_action = 0;
+    control_time = 0;
+    last_period_ms = CONTROL_PERIOD_MS;
+    box_lost_events = 0;
+
+    adaptive_rate_init(&control_rate, CONTROL_PERIOD_MS, FAST_PERIOD_MS, IDLE_PERIOD_MS);
+    adaptive_rate_set_state(&control_rate, STATE_AT_NODE, AT_NODE_PERIOD_MS);
+    adaptive_rate_from_env(&control_rate, state_names, (int)(sizeof(state_names) / sizeof(state_names[0])));
+    estimator_init(&estimator);
+    approach_profile_init(&approach, BASE_SPEED, PICK_DISTANCE, estimator.speed_gain);
+    line_recovery_init(&line_recovery);
+    metrics_init(&metrics, state_names, (int)(sizeof(state_names) / sizeof(state_names[0])));
+}
+
+/**
+ * @brief Current state of the state machine (benchmarks)
+ */
+int controller_state(void) {
+    return current_state;
+}
+
+/**
+ * @brief Name of a state value, or NULL past the last state (replay tools)
+ */
+const char* controller_state_name(int state) {
+    if (state < 0 || state >= (int)(sizeof(state_names) / sizeof(state_names[0]))) return NULL;
+    return state_names[state];
+}
+
+/**
+ * @brief Runs one tick of the state machine on the current sensor values
+ * @param c Pointer to SocketClient structure
+ * @return Milliseconds to wait before the next tick
+ *
+ * Kept separate from control_loop so replay tools can drive the controller
+ * from recorded input without a socket or real-time sleeps.
+ */
+int control_step(SocketClient* c) {
+    int delay_ms = CONTROL_PERIOD_MS;
+    bool retrying = false;
+
+    // Hold still while disconnected or waiting for fresh data; the state machine is kept as is
+    if (!client_ready(c)) {
+        return delay_ms;
+    }
+
+    // Sensor data older than the latency budget: stop and make no decisions on it
+    if (check_watchdog(c) == 0.0f) {
+        set_motor(c, 0, 0);
+        return delay_ms;
+    }
+
+    // Read sensor values
+    const ClientSnapshot* s = client_snapshot(c);
+    float proximity = client_proximity(c);
+    char detected_color_val = detect_color(c);
+    bool at_node = detect_node_n1(c);
+    LineClass line = classify_line(s->line_sensors);
+    float line_error = line_centroid_error(s->line_sensors);
+
+    // Advance the estimator over the last period with the wheel commands in force,
+    // then correct it once per new sensor frame
+    estimator_predict(&estimator, s->motor_left, s->motor_right, last_period_ms / 1000.0f);
+    unsigned long frames = client_stats(c)->frames_received;
+    if (frames != estimator.last_frame) {
+        estimator_correct(&estimator, proximity, line != LINE_LOST, line_error);
+        estimator.last_frame = frames;
+        if (line_recovery_observe(&line_recovery, line != LINE_LOST, line_error, control_time)) {
+            tick_log("Line found again after %.0f ms\n", 1000.0 * (control_time - line_recovery.lost_since));
+        }
+    }
+    float distance = estimator.distance.d;
+    float distance_margin = DISTANCE_CONFIDENCE * distance_filter_sigma(&estimator.distance);
+    float closing_speed = estimator_closing_speed(&estimator, s->motor_left, s->motor_right);
     
-    printf("Starting robot control loop...\n");
-    printf("Current state: %d\n", current_state);
+    // Print sensor readings for debugging
+    tick_log("State: %d, Proximity: %.3f (filtered %.3f +/- %.3f), Color: %c, Has Box: %s, At Node: %s\n", 
+             current_state, proximity, distance, distance_margin, detected_color_val,
+             has_box ? "Yes" : "No", at_node ? "Yes" : "No");
     
-    while (c->running) {
-        // Read sensor values
-        float proximity = c->proximity_distance;
-        char detected_color_val = detect_color(c);
-        bool at_node = detect_node_n1(c);
-        
-        // Print sensor readings for debugging
-        printf("State: %d, Proximity: %.3f, Color: %c, Has Box: %s, At Node: %s\n", 
-               current_state, proximity, detected_color_val, has_box ? "Yes" : "No", at_node ? "Yes" : "No");
-        
-        // State machine logic based on task flow from images
-        switch (current_state) {
-            case STATE_SEARCHING:
-                // Look for a box to pick up in pickup zone
-                if (proximity < BOX_DETECTION_DISTANCE && proximity > 0.1) {
-                    // Box detected, move to approaching state
-                    current_state = STATE_APPROACHING;
-                    printf("Box detected! Switching to APPROACHING state.\n");
-                } else {
-                    // No box detected, search by following line
-                    follow_line(c);
-                }
-                break;
-                
-            case STATE_APPROACHING:
-                // Move towards the detected box
-                if (proximity < CLOSE_DISTANCE) {
-                    // Close enough to pick up
-                    current_state = STATE_PICKING;
-                    printf("Close to box! Switching to PICKING state.\n");
-                } else if (proximity > BOX_DETECTION_DISTANCE) {
-                    // Box moved away or disappeared
-                    current_state = STATE_SEARCHING;
-                    printf("Box lost! Switching back to SEARCHING state.\n");
+    // State machine logic based on task flow from images
+    switch (current_state) {
+        case STATE_SEARCHING:
+            // Look for a box to pick up in pickup zone; only a confident estimate counts
+            if (distance + distance_margin < BOX_DETECTION_DISTANCE &&
+                distance - distance_margin > MIN_VALID_DISTANCE) {
+                // Box detected, move to approaching state without a speed step
+                current_state = STATE_APPROACHING;
+                approach_profile_start(&approach, 0.5f * (s->motor_left + s->motor_right));
+                printf("Box detected! Switching to APPROACHING state.\n");
+            } else {
+                // No box detected, search by following line
+                follow_line(c);
+            }
+            break;
+            
+        case STATE_APPROACHING:
+            // Decelerate into the pick pose and pick once the robot has settled there;
+            // give up only once the box is confidently out of range.
+            if (approach_profile_settled(&approach, distance, closing_speed)) {
+                // Close enough to pick up
+                current_state = STATE_PICKING;
+                printf("Close to box! Switching to PICKING state.\n");
+            } else if (distance - distance_margin > BOX_DETECTION_DISTANCE) {
+                // Box moved away or disappeared
+                current_state = STATE_SEARCHING;
+                box_lost_events++;
+                printf("Box lost! Switching back to SEARCHING state.\n");
+            } else {
+                // Move forward towards box along the speed profile
+                float speed = approach_profile_step(&approach, distance, closing_speed, last_period_ms / 1000.0f);
+                tick_log("Approach speed %.3f, closing at %.3f m/s\n", speed, closing_speed);
+                set_motor(c, speed, speed);
+            }
+            break;
+            
+        case STATE_PICKING:
+            // Pick up the box: start the pick once, then hold still until it completes
+            if (arm_action == 0) {
+                printf("Attempting to pick up box...\n");
+                set_motor(c, 0, 0);
+                arm_action = client_pick(c, NULL, NULL);
+                if (arm_action == 0) {
+                    retrying = true; // Wait a bit before retry
                 } else {
-                    // Move forward towards box
-                    set_motor(c, BASE_SPEED, BASE_SPEED);
+                    detected_color = detected_color_val;  // The box is still in front of the sensor
                 }
                 break;
-                
-            case STATE_PICKING:
-                // Pick up the box
-                printf("Attempting to pick up box...\n");
-                if (pick_box(c)) {
+            }
+            switch (client_action_status(c, arm_action)) {
+                case ACTION_PENDING:
+                    set_motor(c, 0, 0);
+                    tick_log("Waiting for the pick to complete...\n");
+                    break;
+                case ACTION_DONE:
+                    arm_action = 0;
                     has_box = true;
-                    detected_color = detected_color_val;
                     current_state = STATE_NAVIGATING_TO_NODE;
                     printf("Box picked up! Color: %c. Switching to NAVIGATING_TO_NODE state.\n", detected_color);
-                } else {
-                    // Retry picking
-                    SLEEP(100); // Wait a bit before retry
-                }
-                break;
-                
-            case STATE_NAVIGATING_TO_NODE:
-                // Navigate to Node N1 (decision point)
-                if (!has_box) {
-                    // Box was dropped somehow, go back to searching
-                    current_state = STATE_SEARCHING;
-                    printf("Box lost during navigation! Switching to SEARCHING state.\n");
-                } else if (at_node) {
-                    // Reached Node N1, switch to decision state
-                    current_state = STATE_AT_NODE;
-                    at_node_n1 = true;
-                    printf("Reached Node N1! Switching to AT_NODE state.\n");
-                } else {
-                    // Follow line to Node N1
-                    follow_line(c);
-                }
-                break;
-                
-            case STATE_AT_NODE:
-                // At Node N1, detect color and decide drop zone
-                if (!has_box) {
-                    // Box was dropped somehow, go back to searching
-                    current_state = STATE_SEARCHING;
+                    break;
+                default:
+                    // Failed or unanswered: settle in front of the box again and retry
+                    arm_action = 0;
+                    detected_color = 'N';
+                    current_state = STATE_APPROACHING;
+                    approach_profile_start(&approach, 0);
+                    printf("Pick failed! Switching back to APPROACHING state.\n");
+                    break;
+            }
+            break;
+            
+        case STATE_NAVIGATING_TO_NODE:
+            // Navigate to Node N1 (decision point)
+            if (!has_box) {
+                // Box was dropped somehow, go back to searching
+                current_state = STATE_SEARCHING;
+                printf("Box lost during navigation! Switching to SEARCHING state.\n");
+            } else if (at_node) {
+                // Reached Node N1, switch to decision state
+                current_state = STATE_AT_NODE;
+                at_node_n1 = true;
+                printf("Reached Node N1! Switching to AT_NODE state.\n");
+            } else {
+                // Follow line to Node N1
+                follow_line(c);
+            }
+            break;
+            
+        case STATE_AT_NODE:
+            // At Node N1, detect color and decide drop zone
+            if (!has_box) {
+                // Box was dropped somehow, go back to searching
+                current_state = STATE_SEARCHING;
+                at_node_n1 = false;
+                printf("Box lost at node! Switching to SEARCHING state.\n");
+            } else {
+                // Detect color and decide which drop zone to go to
+                if (detected_color != 'N') {
+                    current_state = STATE_NAVIGATING_TO_DROP;
                     at_node_n1 = false;
-                    printf("Box lost at node! Switching to SEARCHING state.\n");
+                    printf("Color detected: %c. Switching to NAVIGATING_TO_DROP state.\n", detected_color);
                 } else {
-                    // Detect color and decide which drop zone to go to
-                    if (detected_color != 'N') {
-                        current_state = STATE_NAVIGATING_TO_DROP;
-                        at_node_n1 = false;
-                        printf("Color detected: %c. Switching to NAVIGATING_TO_DROP state.\n", detected_color);
-                    } else {
-                        // Wait for color detection
-                        printf("Waiting for color detection at Node N1...\n");
-                        SLEEP(50);
-                    }
+                    // Wait for color detection
+                    tick_log("Waiting for color detection at Node N1...\n");
+                    retrying = true;
                 }
-                break;
+            }
+            break;
+            
+        case STATE_NAVIGATING_TO_DROP:
+            // Navigate to specific drop zone based on color
+            if (!has_box) {
+                // Box was dropped somehow, go back to searching
+                current_state = STATE_SEARCHING;
+                printf("Box lost during drop navigation! Switching to SEARCHING state.\n");
+            } else {
+                // Navigate to specific drop zone
+                navigate_to_specific_drop_zone(c, detected_color);
                 
-            case STATE_NAVIGATING_TO_DROP:
-                // Navigate to specific drop zone based on color
-                if (!has_box) {
-                    // Box was dropped somehow, go back to searching
-                    current_state = STATE_SEARCHING;
-                    printf("Box lost during drop navigation! Switching to SEARCHING state.\n");
-                } else {
-                    // Navigate to specific drop zone
-                    navigate_to_specific_drop_zone(c, detected_color);
-                    
-                    // After some time, try to drop
-                    state_counter++;
-                    if (state_counter > 50) { // After some time, try to drop
-                        current_state = STATE_DROPPING;
-                        state_counter = 0;
-                        printf("Reached drop zone. Switching to DROPPING state.\n");
-                    }
+                // After some time, try to drop
+                drop_navigation_ms += last_period_ms;
+                if (drop_navigation_ms > DROP_NAVIGATION_MS) {
+                    current_state = STATE_DROPPING;
+                    drop_navigation_ms = 0;
+                    printf("Reached drop zone. Switching to DROPPING state.\n");
                 }
-                break;
-                
-            case STATE_DROPPING:
-                // Drop the box in correct zone
+            }
+            break;
+            
+        case STATE_DROPPING:
+            // Drop the box in correct zone: start the drop once, then hold still until it completes
+            if (arm_action == 0) {
                 printf("Attempting to drop box in %c zone...\n", detected_color);
-                if (drop_box(c)) {
+                set_motor(c, 0, 0);
+                arm_action = client_drop(c, NULL, NULL);
+                if (arm_action == 0) retrying = true; // Wait a bit before retry
+                break;
+            }
+            switch (client_action_status(c, arm_action)) {
+                case ACTION_PENDING:
+                    set_motor(c, 0, 0);
+                    tick_log("Waiting for the drop to complete...\n");
+                    break;
+                case ACTION_DONE:
+                    arm_action = 0;
                     has_box = false;
                     detected_color = 'N';
                     current_state = STATE_SEARCHING;
                     printf("Box dropped! Switching back to SEARCHING state.\n");
-                } else {
-                    // Retry dropping
-                    SLEEP(100); // Wait a bit before retry
-                }
-                break;
-                
-            default:
-                // Unknown state, reset to searching
-                current_state = STATE_SEARCHING;
-                printf("Unknown state detected! Resetting to SEARCHING state.\n");
-                break;
-        }
+                    break;
+                default:
+                    // Failed or unanswered: try again
+                    arm_action = 0;
+                    retrying = true;
+                    printf("Drop failed, retrying...\n");
+                    break;
+            }
+            break;
+            
+        default:
+            // Unknown state, reset to searching
+            current_state = STATE_SEARCHING;
+            printf("Unknown state detected! Resetting to SEARCHING state.\n");
+            break;
+    }
+
+    // Index state transitions in the recordings
+    if (current_state != recorded_state) client_mark_state(c, current_state);
+    recorded_state = current_state;
+
+    // Record this tick
+    TelemetrySample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp = monotonic_seconds();
+    sample.state = current_state;
+    for (int i = 0; i < 5; i++) sample.ir[i] = s->line_sensors[i];
+    sample.proximity = proximity;
+    sample.pid_error = estimator.offset.x;
+    sample.color_r = s->color_r;
+    sample.color_g = s->color_g;
+    sample.color_b = s->color_b;
+    sample.left = s->motor_left;
+    sample.right = s->motor_right;
+    telemetry_record(&telemetry, &sample);
+    metrics_record_tick(&metrics, sample.timestamp, current_state, line != LINE_LOST, estimator.offset.x);
+
+    // Faster near junctions and while the line moves quickly, slower when standing still.
+    // The rate runs on control time (sum of periods) so replays behave like live runs.
+    RateInputs rate_in;
+    rate_in.near_junction = at_node || line == LINE_INTERSECTION;
+    rate_in.line_error = estimator.offset.x;
+    rate_in.left = s->motor_left;
+    rate_in.right = s->motor_right;
+    delay_ms = adaptive_rate_next(&control_rate, current_state, &rate_in, control_time);
+    if (retrying && delay_ms < RETRY_PERIOD_MS) delay_ms = RETRY_PERIOD_MS;
+
+    control_time += delay_ms / 1000.0;
+    last_period_ms = delay_ms;
+    return delay_ms;
+}
+
+/**
+ * @brief Main control loop thread for robot behavior
+ */
+void* control_loop(void* arg) {
+    SocketClient* c = (SocketClient*)arg;
+    rt_thread_apply(&control_rt, "control");
+    
+    printf("Starting robot control loop...\n");
+    printf("Current state: %d\n", current_state);
 
-        SLEEP(50);  // Wait 50ms before next iteration
+    recorded_state = current_state;
+    client_mark_state(c, current_state);
+    
+    // Ticks are paced against absolute deadlines so the step time does not add up as drift;
+    // a stop request cuts the wait short instead of waiting out the period
+    rt_cycle_start(&control_timer);
+    control_timer.wake_fd = lifecycle_fd();
+    while (client_running(c) && !lifecycle_stop_requested()) {
+        rt_cycle_wait(&control_timer, control_step(c));
     }
     return NULL;
 }
 
+#ifndef TASK2A_NO_MAIN
 /**
  * @brief Main function - Entry point of the program
  */
 int main() {
+    // Ctrl+C / SIGTERM request an orderly stop instead of killing the process
+    if (!lifecycle_init()) {
+        printf("Failed to install signal handlers\n");
+    }
+
+    ClientConfig config;
+    client_config_init(&config);
+    watchdog_init_from_env(&watchdog);
+    config.watchdog = &watchdog;
+
+    // CB_ACTION_ACKS=1: the server acknowledges PICK/DROP with their request id
+    const char* acks = getenv("CB_ACTION_ACKS");
+    action_acks = acks && atoi(acks) != 0;
+    config.action_acks = action_acks;
+
+    // CB_MOTOR_REFRESH_MS=N: resend an unchanged wheel command only every N ms
+    const char* refresh = getenv("CB_MOTOR_REFRESH_MS");
+    if (refresh) config.motor_refresh_ms = atoi(refresh);
+
+    rt_thread_config_from_env(&control_rt, "CONTROL");
+    rt_thread_config_from_env(&receive_rt, "RECEIVE");
+    config.receive_rt = &receive_rt;
+    rt_lock_memory_from_env();  // Before the threads start, so their stacks are locked too
+
+    // Recordings must be attached before the receive thread starts
+    const char* recording_base = getenv("CB_RECORDING");
+    if (recording_base && *recording_base) {
+        char path[RECORDING_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s.in", recording_base);
+        if (recorder_open(&input_recording, path)) {
+            config.input_recorder = &input_recording;
+            printf("Recording input to %s\n", path);
+        } else {
+            printf("Failed to open input recording %s: %s\n", path, strerror(errno));
+        }
+        snprintf(path, sizeof(path), "%s.out", recording_base);
+        if (recorder_open(&output_recording, path)) {
+            config.output_recorder = &output_recording;
+            printf("Recording output to %s\n", path);
+        } else {
+            printf("Failed to open output recording %s: %s\n", path, strerror(errno));
+        }
+    }
+
+    // CB_FAULT_*: impair the link to test how the controller copes
+    FaultConfig faults;
+    FaultLink* fault_link = NULL;
+    if (fault_config_from_env(&faults) && (fault_link = fault_link_create(config.transport, &faults)) != NULL) {
+        config.transport = &fault_transport;
+        config.transport_state = fault_link;
+        fault_config_print(&faults, "Fault injection");
+    }
+
     // Attempt to connect to CoppeliaSim server
-    if (!connect_to_server(&client, "127.0.0.1", 50002)) {
+    client = client_create(&config);
+    if (!client || !client_connect(client)) {
         printf("Failed to connect to CoppeliaSim server. Make sure:\n");
         printf("1. CoppeliaSim is running\n");
         printf("2. The simulation scene is loaded\n");
         printf("3. The ZMQ remote API is enabled on port 50002\n");
+        client_destroy(client);
+        fault_link_destroy(fault_link);
         return -1;
     }
     
     printf("Successfully connected to CoppeliaSim server!\n");
+
+    if (!telemetry_init(&telemetry, TELEMETRY_DEFAULT_CAPACITY)) {
+        printf("Telemetry allocation failed, continuing without recording\n");
+    }
+    init_controller();
+
+    // CB_METRICS_SOCKET: serve live counters instead of watching the per-tick log
+    const char* metrics_path = getenv("CB_METRICS_SOCKET");
+    if (metrics_path && *metrics_path && metrics_server_start(&metrics_server, metrics_path, &metrics, client)) {
+        printf("Metrics on %s\n", metrics_path);
+    }
     printf("Starting control thread...\n");
     
     // Start the control thread for robot behavior
 #ifdef _WIN32
-    HANDLE control_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)control_loop, &client, 0, NULL);
+    HANDLE control_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)control_loop, client, 0, NULL);
 #else
     pthread_t control_thread;
-    pthread_create(&control_thread, NULL, control_loop, &client);
+    pthread_create(&control_thread, NULL, control_loop, client);
 #endif
 
-    // Main loop: Display sensor data continuously
+    // Main loop: wait for a stop request or for the connection to give up
     printf("Monitoring sensor data... (Press Ctrl+C to exit)\n");
-    while (1) {
-        SLEEP(100);  // Update display every 100ms
+    while (client_running(client) && !lifecycle_wait(100)) {
     }
+    bool connection_lost = !client_running(client);
+    lifecycle_request_stop();  // Also stops the control loop if the connection gave up
 
-    // Cleanup
-    printf("Disconnecting...\n");
-    disconnect(&client);
-    return 0;
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+    // Cleanup: stop the controller first so nothing overrides the final stop command
+    printf("Stopping control thread...\n");
+#ifdef _WIN32
+    WaitForSingleObject(control_thread, INFINITE);
+    CloseHandle(control_thread);
+#else
+    pthread_join(control_thread, NULL);
+#endif
+    set_motor(client, 0, 0);
+    metrics_server_stop(&metrics_server);
 
+    const ClientStats* stats = client_stats(client);
+    printf("Arm actions: %lu sent, %lu done, %lu failed, last %.0f ms, max %.0f ms\n",
+           stats->actions_sent, stats->actions_done, stats->actions_failed,
+           stats->last_action_s * 1000.0, stats->max_action_s * 1000.0);
+    printf("Link: %lu lines, %lu parse errors, %lu truncated; %lu wheel commands, %lu coalesced\n",
+           stats->lines_received, stats->parse_errors, stats->lines_truncated, stats->motor_commands,
+           stats->motor_coalesced);
 
+    printf("Disconnecting...\n");
+    client_destroy(client);
+    if (fault_link) fault_injector_report(&fault_link->injector, "Fault injection");
+    fault_link_destroy(fault_link);
+    printf("Watchdog: %u stop events, %u slowdowns, max frame age %.0f ms (budget %.0f ms)\n",
+           watchdog.stop_events, watchdog.degrade_events, watchdog.max_age * 1000.0, watchdog.budget * 1000.0);
+    rt_cycle_report(&control_timer, "Control loop");
+    adaptive_rate_report(&control_rate, "Control rate");
+    printf("Estimator: %lu proximity outliers rejected, %lu approaches abandoned\n",
+           estimator.distance.rejects, box_lost_events);
+    line_recovery_report(&line_recovery, "Line recovery");
+
+    if (telemetry.count > 0 && telemetry_export(&telemetry, TELEMETRY_FILE)) {
+        printf("Telemetry written to %s (%zu ticks)\n", TELEMETRY_FILE, telemetry.count);
+    }
+    telemetry_destroy(&telemetry);
+    recorder_close(&input_recording);
+    recorder_close(&output_recording);
+    return connection_lost ? 1 : 0;
+}
+#endif // TASK2A_NO_MAIN
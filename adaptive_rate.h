@@ -0,0 +1,144 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+
+/*
+ * Adaptive control-loop period.
+ *
+ * Each controller state has a base period. Every tick the controller reports
+ * what it sees and the scheduler picks the next period:
+ *
+ *   near a junction, or line error changing fast   fast_period_ms
+ *   robot stationary                                max(base, idle_period_ms)
+ *   otherwise                                       base period of the state
+ *
+ * The fast rate is held for ADAPTIVE_RATE_HOLD_S after the last trigger so a
+ * junction is not left at the slow rate half way through. All periods can be
+ * overridden from the environment:
+ *
+ *   CB_RATE_FAST_MS, CB_RATE_IDLE_MS, CB_RATE_<STATE>_MS (state names as
+ *   passed to adaptive_rate_from_env, e.g. CB_RATE_AT_NODE_MS=200)
+ */
+
+#define ADAPTIVE_RATE_MAX_STATES 16
+#define ADAPTIVE_RATE_HOLD_S 0.25            // Keep the fast rate this long after a trigger
+#define ADAPTIVE_RATE_ERROR_SLEW 4.0f        // Line error units per second that count as "changing fast"
+#define ADAPTIVE_RATE_STILL_SPEED 0.02f      // Wheel speed below which the robot counts as stationary
+
+// What the controller saw this tick
+typedef struct {
+    bool near_junction;                 // Junction / node pattern under the sensors
+    float line_error;                   // Line position error (any consistent unit)
+    float left, right;                  // Commanded wheel speeds
+} RateInputs;
+
+typedef struct {
+    int state_period_ms[ADAPTIVE_RATE_MAX_STATES];
+    int fast_period_ms;
+    int idle_period_ms;
+    float error_slew;                   // Trigger for the fast rate, error units per second
+
+    // Tracking
+    float prev_error;
+    double prev_time;
+    double fast_until;
+
+    // Counters
+    unsigned long ticks;
+    unsigned long fast_ticks;
+    unsigned long idle_ticks;
+    double scheduled_ms;                // Sum of all returned periods
+} AdaptiveRate;
+
+/**
+ * @brief Sets every state to the same base period
+ * @param r Pointer to AdaptiveRate structure
+ * @param base_period_ms Base period of every state
+ * @param fast_period_ms Period near junctions and during fast error changes
+ * @param idle_period_ms Period while the robot is stationary
+ */
+static inline void adaptive_rate_init(AdaptiveRate* r, int base_period_ms, int fast_period_ms, int idle_period_ms) {
+    memset(r, 0, sizeof(*r));
+    for (int i = 0; i < ADAPTIVE_RATE_MAX_STATES; i++) r->state_period_ms[i] = base_period_ms;
+    r->fast_period_ms = fast_period_ms;
+    r->idle_period_ms = idle_period_ms;
+    r->error_slew = ADAPTIVE_RATE_ERROR_SLEW;
+}
+
+/**
+ * @brief Sets the base period of one state
+ */
+static inline void adaptive_rate_set_state(AdaptiveRate* r, int state, int period_ms) {
+    if (state >= 0 && state < ADAPTIVE_RATE_MAX_STATES && period_ms > 0) r->state_period_ms[state] = period_ms;
+}
+
+/**
+ * @brief Applies CB_RATE_* overrides
+ * @param r Pointer to AdaptiveRate structure
+ * @param state_names Name of each state, indexed by state value (NULL entries are skipped)
+ * @param state_count Number of entries in state_names
+ */
+static inline void adaptive_rate_from_env(AdaptiveRate* r, const char* const* state_names, int state_count) {
+    char name[64];
+    const char* v;
+
+    if ((v = getenv("CB_RATE_FAST_MS")) != NULL && atoi(v) > 0) r->fast_period_ms = atoi(v);
+    if ((v = getenv("CB_RATE_IDLE_MS")) != NULL && atoi(v) > 0) r->idle_period_ms = atoi(v);
+    for (int i = 0; i < state_count && i < ADAPTIVE_RATE_MAX_STATES; i++) {
+        if (!state_names[i]) continue;
+        snprintf(name, sizeof(name), "CB_RATE_%s_MS", state_names[i]);
+        if ((v = getenv(name)) != NULL) adaptive_rate_set_state(r, i, atoi(v));
+    }
+}
+
+/**
+ * @brief Picks the period until the next tick
+ * @param r Pointer to AdaptiveRate structure
+ * @param state Current controller state
+ * @param in What the controller saw this tick
+ * @param now Monotonic time in seconds
+ * @return Milliseconds until the next tick
+ */
+static inline int adaptive_rate_next(AdaptiveRate* r, int state, const RateInputs* in, double now) {
+    int period = (state >= 0 && state < ADAPTIVE_RATE_MAX_STATES) ? r->state_period_ms[state] : r->state_period_ms[0];
+
+    // Error slew rate since the previous tick
+    bool fast_error = false;
+    if (r->prev_time > 0 && now > r->prev_time) {
+        float slew = fabsf(in->line_error - r->prev_error) / (float)(now - r->prev_time);
+        fast_error = slew > r->error_slew;
+    }
+    r->prev_error = in->line_error;
+    r->prev_time = now;
+
+    if (in->near_junction || fast_error) r->fast_until = now + ADAPTIVE_RATE_HOLD_S;
+    bool still = fabsf(in->left) < ADAPTIVE_RATE_STILL_SPEED && fabsf(in->right) < ADAPTIVE_RATE_STILL_SPEED;
+
+    if (now < r->fast_until && !still) {
+        if (r->fast_period_ms < period) period = r->fast_period_ms;
+        r->fast_ticks++;
+    } else if (still) {
+        if (r->idle_period_ms > period) period = r->idle_period_ms;
+        r->idle_ticks++;
+    }
+
+    r->ticks++;
+    r->scheduled_ms += period;
+    return period;
+}
+
+/**
+ * @brief Prints the tick count, mean period and share of fast/idle ticks
+ */
+static inline void adaptive_rate_report(const AdaptiveRate* r, const char* name) {
+    if (r->ticks == 0) return;
+    printf("%s: %lu ticks, mean period %.1f ms, %.0f%% fast, %.0f%% idle\n", name, r->ticks,
+           r->scheduled_ms / r->ticks, 100.0 * r->fast_ticks / r->ticks, 100.0 * r->idle_ticks / r->ticks);
+}
+
+#endif // ADAPTIVE_RATE_H
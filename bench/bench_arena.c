@@ -0,0 +1,681 @@
+/*
+ * Headless arena benchmark: end-to-end sorting throughput of a controller.
+ *
+ * The controller runs in closed loop against a small simulated arena, entirely
+ * on simulated time, so a seed always produces the same run:
+ *
+ *   - a closed track, unrolled to x in [0, ARENA_TRACK_LENGTH), with a gently
+ *     winding line, Node N1 (a cross line: all five sensors on black) and
+ *     red, green and blue drop zones after the node, in one of two layouts:
+ *       painted   patches on the floor along the line, told apart by the
+ *                 color sensor (botoverturns' default)
+ *       branches  the branches at the node: turning right leads to red,
+ *                 going straight on to blue, turning left to green; a drop
+ *                 counts for the branch the robot turned into after reaching
+ *                 the node (Task 2A's default, which routes by turning)
+ *   - one box of seeded random color waiting on the line at the pickup spot;
+ *     a new one appears there after every drop, once the robot is away from it
+ *   - a differential-drive robot with first-order wheel lag and a per-seed
+ *     wheel gain mismatch, five IR line sensors and a proximity and color
+ *     sensor at the front, all with seeded noise
+ *
+ * Sensor lines go through client_feed() every ARENA_FRAME_MS and commands are
+ * read back from the client transport. PICK/DROP are acknowledged
+ * ("A:<id>,OK" / "A:<id>,FAIL") once the arm has finished: a pick succeeds if
+ * the box is in reach when the gripper closes, a drop is correct if it lands
+ * in the zone of the box color.
+ *
+ *   ./bench_arena_task2a       [--seeds N] [--first-seed S] [--duration S] [--zones LAYOUT] [--json FILE]
+ *   ./bench_arena_botoverturns [--seeds N] [--first-seed S] [--duration S] [--zones LAYOUT] [--json FILE]
+ *
+ * Reports boxes sorted per minute (all and correctly sorted), the mis-sort
+ * rate, the share of time spent searching, approaching, picking, in transit
+ * and dropping, and the control-step latency (wall time, p50/p99/max).
+ * stdout also carries the controller's own messages.
+ *
+ * Both directions pass through a FaultInjector on simulated time. It is off
+ * unless CB_FAULT_* is set (see fault_injection.h); its seed is offset by the
+ * arena seed, so impaired runs are just as reproducible.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../coppeliasim_client.h"
+#include "../telemetry.h"
+#include "../clock_util.h"
+#include "../fault_injection.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_SEEDS 5
+#define DEFAULT_DURATION_S 300.0
+
+// Arena layout, meters
+#define ARENA_TRACK_LENGTH 6.0
+#define ARENA_LINE_AMPLITUDE 0.03        // Lateral swing of the winding line
+#define ARENA_LINE_WAVELENGTH 2.0        // Must divide the track length
+#define ARENA_LINE_WIDTH 0.012           // Width parameter of the IR response
+#define ARENA_PICKUP_X 1.0
+#define ARENA_NODE_X 2.0
+#define ARENA_NODE_HALF_WIDTH 0.02
+#define ARENA_NODE_ARM 0.1               // The cross line reaches this far to each side of the line
+#define ARENA_ZONE_LENGTH 0.3
+static const double zone_start[3] = {2.4, 2.9, 3.4};  // Red, green, blue (painted layout)
+#define ARENA_BRANCH_TURN (M_PI / 4)     // Net turn after the node that takes a side branch
+#define ARENA_BRANCH_STRAIGHT 0.2        // The straight-on branch starts this far past the node ...
+#define ARENA_BRANCH_REACH 1.0           // ... and no branch reaches farther
+
+typedef enum { ZONES_PAINTED, ZONES_BRANCHES, ZONE_LAYOUT_COUNT } ZoneLayout;
+static const char* const zone_layout_names[ZONE_LAYOUT_COUNT] = {"painted", "branches"};
+
+// Robot
+#define ROBOT_WHEEL_GAIN 0.5             // m/s per unit of wheel command
+#define ROBOT_TRACK_WIDTH 0.1            // m between the wheels
+#define ROBOT_WHEEL_LAG_S 0.05           // Wheel speed time constant
+#define ROBOT_SENSOR_AHEAD 0.05          // Sensors sit this far ahead of the axle
+#define ROBOT_SENSOR_PITCH 0.015         // Spacing of the five IR sensors
+#define ROBOT_PROXIMITY_RANGE 1.0        // Reading when nothing is in range
+#define ROBOT_BOX_HALF_WIDTH 0.05
+#define ROBOT_PICK_MIN 0.03              // Box must be this far ahead of the sensors ...
+#define ROBOT_PICK_MAX 0.30              // ... and no farther when the gripper closes
+
+// Timing, seconds
+#define ARENA_PHYSICS_DT 0.001
+#define ARENA_FRAME_MS 10
+#define ARENA_PICK_S 0.4
+#define ARENA_DROP_S 0.5
+
+// Controller under test
+#if defined(ARENA_BOTOVERTURNS)
+#define CONTROLLER_NAME "botoverturns"
+#define CONTROLLER_ZONES ZONES_PAINTED   // Drops where the color sensor matches the box
+void botoverturns_init(void);
+int botoverturns_step(SocketClient* c, double now);
+int botoverturns_state(void);
+#else
+#define CONTROLLER_NAME "task2a"
+#define CONTROLLER_ZONES ZONES_BRANCHES  // Turns at the node by color, then drops after a fixed time
+void init_controller(void);
+int control_step(SocketClient* c);
+int controller_state(void);
+#endif
+extern bool action_acks;
+extern TelemetryStore telemetry;
+
+typedef enum { PHASE_SEARCH, PHASE_APPROACH, PHASE_PICK, PHASE_TRANSIT, PHASE_DROP, PHASE_COUNT } Phase;
+static const char* const phase_names[PHASE_COUNT] = {"search", "approach", "pick", "transit", "drop"};
+
+static void controller_init(void) {
+    action_acks = true;  // The arena acknowledges every action
+#if defined(ARENA_BOTOVERTURNS)
+    botoverturns_init();
+#else
+    init_controller();
+#endif
+}
+
+static int controller_step(SocketClient* c, double now) {
+#if defined(ARENA_BOTOVERTURNS)
+    return botoverturns_step(c, now);
+#else
+    (void)now;  // Task 2A keeps its own control time
+    return control_step(c);
+#endif
+}
+
+// State values as declared in botoverturns.c / Task2a.c
+static Phase controller_phase(void) {
+#if defined(ARENA_BOTOVERTURNS)
+    static const Phase phases[] = {PHASE_SEARCH, PHASE_TRANSIT, PHASE_DROP, PHASE_APPROACH, PHASE_PICK};
+    int state = botoverturns_state();
+#else
+    static const Phase phases[] = {PHASE_SEARCH, PHASE_APPROACH, PHASE_PICK, PHASE_TRANSIT,
+                                   PHASE_TRANSIT, PHASE_TRANSIT, PHASE_DROP};
+    int state = controller_state();
+#endif
+    return (state >= 0 && state < (int)(sizeof(phases) / sizeof(phases[0]))) ? phases[state] : PHASE_SEARCH;
+}
+
+// ==================== Arena ====================
+
+typedef struct {
+    unsigned int id;                    // Request id of the action
+    bool pick;
+    double done_at;
+} ArmAction;
+
+typedef struct {
+    uint32_t rng;
+    double time;
+
+    // Robot pose and wheels
+    double x, y, heading;
+    double wheel_left, wheel_right;     // Actual wheel speeds, m/s
+    double gain_left, gain_right;       // Per-seed wheel gain mismatch
+    float command_left, command_right;  // Last wheel command received
+
+    // Box waiting at the pickup spot, and the one being carried
+    bool box_present;
+    bool box_due;                       // Next box appears once the robot has left the pickup spot
+    int box_color;                      // 0 red, 1 green, 2 blue
+    bool carrying;
+    int carried_color;
+    bool node_passed;                   // The carried box has reached the node ...
+    double node_heading;                // ... with the robot at this heading
+
+    ArmAction arm[8];
+    int arm_count;
+
+    // Link between the arena and the client
+    FaultInjector link;
+    char command[64];                   // Command being assembled from the link
+    int command_length;
+
+    // Results
+    unsigned long sorted;
+    unsigned long correct;
+    unsigned long picks_failed;
+    double phase_time[PHASE_COUNT];
+} ArenaSim;
+
+static ArenaSim arena;
+static ZoneLayout zone_layout = CONTROLLER_ZONES;
+
+static const float box_rgb[3][3] = {{0.85f, 0.10f, 0.10f}, {0.10f, 0.85f, 0.10f}, {0.10f, 0.10f, 0.85f}};
+static const float floor_rgb[3] = {0.05f, 0.05f, 0.05f};
+
+static float arena_noise(float amplitude) {
+    arena.rng = arena.rng * 1664525u + 1013904223u;
+    return ((float)(arena.rng >> 8) / 16777216.0f - 0.5f) * 2.0f * amplitude;
+}
+
+static int arena_random_color(void) {
+    arena.rng = arena.rng * 1664525u + 1013904223u;
+    return (int)((arena.rng >> 8) % 3);
+}
+
+static double wrap_x(double x) {
+    x = fmod(x, ARENA_TRACK_LENGTH);
+    return x < 0 ? x + ARENA_TRACK_LENGTH : x;
+}
+
+// Signed shortest distance from a to b along the track
+static double track_delta(double a, double b) {
+    double d = wrap_x(b - a);
+    return d > ARENA_TRACK_LENGTH / 2 ? d - ARENA_TRACK_LENGTH : d;
+}
+
+static double line_y(double x) {
+    return ARENA_LINE_AMPLITUDE * sin(2 * M_PI * x / ARENA_LINE_WAVELENGTH);
+}
+
+static float clamp01(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+// IR reading at a floor point: dark on the line and on the node's cross line
+static float ir_reading(double px, double py) {
+    if (fabs(track_delta(ARENA_NODE_X, px)) < ARENA_NODE_HALF_WIDTH && fabs(py - line_y(px)) < ARENA_NODE_ARM) {
+        return clamp01(0.05f + arena_noise(0.03f));
+    }
+    double d = (py - line_y(px)) / ARENA_LINE_WIDTH;
+    return clamp01((float)(1.0 - exp(-d * d)) + arena_noise(0.03f));
+}
+
+// Distance from the front sensors to the waiting box along the heading, or -1 if out of the beam
+static double box_ahead(void) {
+    if (!arena.box_present) return -1;
+    double fx = arena.x + ROBOT_SENSOR_AHEAD * cos(arena.heading);
+    double fy = arena.y + ROBOT_SENSOR_AHEAD * sin(arena.heading);
+    double dx = track_delta(fx, ARENA_PICKUP_X);
+    double dy = line_y(ARENA_PICKUP_X) - fy;
+    double forward = dx * cos(arena.heading) + dy * sin(arena.heading);
+    double lateral = -dx * sin(arena.heading) + dy * cos(arena.heading);
+    if (forward <= 0 || forward >= ROBOT_PROXIMITY_RANGE || fabs(lateral) > ROBOT_BOX_HALF_WIDTH) return -1;
+    return forward;
+}
+
+// Painted zone under a point of the line, or -1
+static int zone_at(double x) {
+    if (zone_layout != ZONES_PAINTED) return -1;
+    for (int i = 0; i < 3; i++) {
+        double d = track_delta(zone_start[i], x);
+        if (d >= 0 && d < ARENA_ZONE_LENGTH) return i;
+    }
+    return -1;
+}
+
+// Branch the robot has taken since carrying the box to the node, or -1
+static int branch_at(void) {
+    if (!arena.node_passed) return -1;
+    // Distance past the node in the direction the robot arrived from (it may run the loop either way)
+    double past = track_delta(ARENA_NODE_X, arena.x + ROBOT_SENSOR_AHEAD * cos(arena.heading));
+    if (cos(arena.node_heading) < 0) past = -past;
+    if (fabs(past) > ARENA_BRANCH_REACH) return -1;
+    double turn = arena.heading - arena.node_heading;  // Not wrapped: a full turn and back is no turn
+    if (turn <= -ARENA_BRANCH_TURN) return 0;  // Right: red
+    if (turn >= ARENA_BRANCH_TURN) return 1;   // Left: green
+    return past >= ARENA_BRANCH_STRAIGHT ? 2 : -1;
+}
+
+// Zone a box released now lands in, or -1
+static int drop_zone(void) {
+    if (zone_layout == ZONES_BRANCHES) return branch_at();
+    // The box is released in front of the robot, under the color sensor
+    return zone_at(arena.x + ROBOT_SENSOR_AHEAD * cos(arena.heading));
+}
+
+/**
+ * @brief Writes the sensor line of the current arena state
+ */
+static int arena_sensor_line(char* line, size_t size) {
+    float ir[5];
+    double c = cos(arena.heading), s = sin(arena.heading);
+    for (int k = 0; k < 5; k++) {
+        double side = (k - 2) * ROBOT_SENSOR_PITCH;  // Positive to the right of the robot
+        ir[k] = ir_reading(arena.x + ROBOT_SENSOR_AHEAD * c + side * s, arena.y + ROBOT_SENSOR_AHEAD * s - side * c);
+    }
+
+    double box = box_ahead();
+    float proximity = box > 0 ? (float)box + arena_noise(0.005f) : ROBOT_PROXIMITY_RANGE;
+    const float* rgb = floor_rgb;
+    int zone = zone_at(arena.x + ROBOT_SENSOR_AHEAD * c);
+    if (box > 0) rgb = box_rgb[arena.box_color];
+    else if (zone >= 0) rgb = box_rgb[zone];
+
+    return snprintf(line, size, "S:%.3f,%.3f,%.3f,%.3f,%.3f;P:%.4f;C:%.3f,%.3f,%.3f\n",
+                    ir[0], ir[1], ir[2], ir[3], ir[4], proximity,
+                    clamp01(rgb[0] + arena_noise(0.03f)), clamp01(rgb[1] + arena_noise(0.03f)),
+                    clamp01(rgb[2] + arena_noise(0.03f)));
+}
+
+/**
+ * @brief Advances the robot by dt seconds
+ */
+static void arena_move(double dt) {
+    double alpha = dt / ROBOT_WHEEL_LAG_S;
+    arena.wheel_left += (arena.gain_left * arena.command_left - arena.wheel_left) * alpha;
+    arena.wheel_right += (arena.gain_right * arena.command_right - arena.wheel_right) * alpha;
+
+    double v = 0.5 * (arena.wheel_left + arena.wheel_right);
+    double box = box_ahead();
+    if (box > 0 && box < 0.02 && v > 0) v = 0;  // Pushing against the box
+    arena.heading += (arena.wheel_right - arena.wheel_left) / ROBOT_TRACK_WIDTH * dt;
+    arena.x = wrap_x(arena.x + v * cos(arena.heading) * dt);
+    arena.y += v * sin(arena.heading) * dt;
+
+    // The branches count from where the sensors first reach the node with the box
+    double sx = arena.x + ROBOT_SENSOR_AHEAD * cos(arena.heading);
+    double sy = arena.y + ROBOT_SENSOR_AHEAD * sin(arena.heading);
+    if (arena.carrying && !arena.node_passed && fabs(track_delta(ARENA_NODE_X, sx)) < ARENA_NODE_HALF_WIDTH &&
+        fabs(sy - line_y(sx)) < ARENA_NODE_ARM) {
+        arena.node_passed = true;
+        arena.node_heading = arena.heading;
+    }
+}
+
+/**
+ * @brief Puts the next box at the pickup spot once the robot is clear of it
+ */
+static void arena_place_box(void) {
+    if (!arena.box_due || fabs(track_delta(arena.x, ARENA_PICKUP_X)) < ROBOT_PROXIMITY_RANGE) return;
+    arena.box_due = false;
+    arena.box_present = true;
+    arena.box_color = arena_random_color();
+}
+
+/**
+ * @brief Finishes the arm actions that are due and acknowledges them
+ */
+static void arena_finish_actions(void) {
+    for (int i = 0; i < arena.arm_count;) {
+        ArmAction* a = &arena.arm[i];
+        if (a->done_at > arena.time) {
+            i++;
+            continue;
+        }
+        bool ok;
+        if (a->pick) {
+            double box = box_ahead();
+            ok = !arena.carrying && box >= ROBOT_PICK_MIN && box <= ROBOT_PICK_MAX;
+            if (ok) {
+                arena.carrying = true;
+                arena.carried_color = arena.box_color;
+                arena.node_passed = false;
+                arena.box_present = false;
+            } else {
+                arena.picks_failed++;
+            }
+        } else {
+            ok = arena.carrying;
+            if (ok) {
+                arena.carrying = false;
+                arena.sorted++;
+                if (drop_zone() == arena.carried_color) arena.correct++;
+                arena.box_due = true;
+            }
+        }
+        char reply[32];
+        int n = snprintf(reply, sizeof(reply), "A:%u,%s\n", a->id, ok ? "OK" : "FAIL");
+        fault_push(&arena.link, &arena.link.rx, reply, n, arena.time);
+        arena.arm[i] = arena.arm[--arena.arm_count];
+    }
+}
+
+/**
+ * @brief Applies one command line from the controller
+ */
+static void arena_command(const char* text) {
+    float left, right;
+    unsigned int id = 0;
+    if (sscanf(text, "L:%f;R:%f", &left, &right) == 2) {
+        arena.command_left = left;
+        arena.command_right = right;
+    } else if ((sscanf(text, "PICK:%u", &id) == 1 || sscanf(text, "DROP:%u", &id) == 1) &&
+               arena.arm_count < (int)(sizeof(arena.arm) / sizeof(arena.arm[0]))) {
+        ArmAction* a = &arena.arm[arena.arm_count++];
+        a->id = id;
+        a->pick = text[0] == 'P';
+        a->done_at = arena.time + (a->pick ? ARENA_PICK_S : ARENA_DROP_S);
+    }
+}
+
+/**
+ * @brief Delivers what the link lets through: sensor lines and acks to the client, commands to the arena
+ */
+static void arena_exchange(SocketClient* c) {
+    char buffer[512];
+    int n;
+    while ((n = fault_pull(&arena.link, &arena.link.rx, buffer, (int)sizeof(buffer), arena.time)) > 0) {
+        client_feed(c, buffer, n);
+    }
+    while ((n = fault_pull(&arena.link, &arena.link.tx, buffer, (int)sizeof(buffer), arena.time)) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buffer[i] == '\n') {
+                arena.command[arena.command_length] = '\0';
+                arena_command(arena.command);
+                arena.command_length = 0;
+            } else if (arena.command_length < (int)sizeof(arena.command) - 1) {
+                arena.command[arena.command_length++] = buffer[i];
+            }
+        }
+    }
+}
+
+// ==================== Transport ====================
+// Commands from the controller enter the link here; nothing is ever read
+
+static int arena_open(ClientConnection* conn, const char* address, int port) {
+    (void)conn; (void)address; (void)port;
+    return 1;
+}
+
+static int arena_read(ClientConnection* conn, char* buffer, int size) {
+    (void)conn; (void)buffer; (void)size;
+    return 0;
+}
+
+static int arena_write(ClientConnection* conn, const char* data, int length) {
+    (void)conn;
+    fault_push(&arena.link, &arena.link.tx, data, length, arena.time);
+    return length;
+}
+
+static void arena_close(ClientConnection* conn) {
+    (void)conn;
+}
+
+static const ClientTransport arena_transport = {"arena", arena_open, arena_read, arena_write, arena_close};
+
+// ==================== Runs ====================
+
+typedef struct {
+    double* data;
+    size_t count;
+    size_t capacity;
+} LatencyLog;
+
+static int latency_add(LatencyLog* log, double value) {
+    if (log->count == log->capacity) {
+        size_t cap = log->capacity ? log->capacity * 2 : 1 << 16;
+        double* data = (double*)realloc(log->data, cap * sizeof(double));
+        if (!data) return 0;
+        log->data = data;
+        log->capacity = cap;
+    }
+    log->data[log->count++] = value;
+    return 1;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const LatencyLog* log, double p) {
+    if (log->count == 0) return 0;
+    size_t i = (size_t)(log->count * p);
+    return log->data[i < log->count ? i : log->count - 1];
+}
+
+/**
+ * @brief Runs one seed for duration seconds of simulated time
+ * @return 1 on success, 0 if the client could not be set up
+ */
+static int run_seed(uint32_t seed, double duration, const FaultConfig* faults, LatencyLog* latency) {
+    memset(&arena, 0, sizeof(arena));
+    FaultConfig link = *faults;
+    link.seed += seed;
+    fault_injector_init(&arena.link, &link);
+    arena.rng = seed * 2654435761u + 1;
+    arena.gain_left = ROBOT_WHEEL_GAIN * (1.0 + arena_noise(0.05f));
+    arena.gain_right = ROBOT_WHEEL_GAIN * (1.0 + arena_noise(0.05f));
+    arena.y = line_y(0) + arena_noise(0.005f);
+    arena.heading = arena_noise(0.1f);
+    arena.box_present = true;
+    arena.box_color = arena_random_color();
+
+    ClientConfig config;
+    client_config_init(&config);
+    config.transport = &arena_transport;
+    config.action_acks = true;
+    config.motor_refresh_ms = 0;  // Coalescing runs on wall time; the arena runs on simulated time
+    controller_init();
+    SocketClient* c = client_create(&config);
+    if (!c || !client_open(c)) {
+        client_destroy(c);
+        return 0;
+    }
+
+    char line[160];
+    double next_frame = 0;
+    double next_tick = 0;
+    double last_tick = 0;
+    Phase phase = PHASE_SEARCH;
+    while (arena.time < duration) {
+        if (arena.time >= next_frame) {
+            fault_push(&arena.link, &arena.link.rx, line, arena_sensor_line(line, sizeof(line)), arena.time);
+            next_frame += ARENA_FRAME_MS / 1000.0;
+        }
+        arena_finish_actions();
+        arena_place_box();
+        arena_exchange(c);
+        if (arena.time >= next_tick) {
+            arena.phase_time[phase] += arena.time - last_tick;
+            last_tick = arena.time;
+
+            double t0 = monotonic_seconds();
+            int period = controller_step(c, arena.time);
+            latency_add(latency, monotonic_seconds() - t0);
+
+            phase = controller_phase();
+            next_tick += (period > 0 ? period : 1) / 1000.0;
+            arena_exchange(c);
+        }
+        arena_move(ARENA_PHYSICS_DT);
+        arena.time += ARENA_PHYSICS_DT;
+    }
+    arena.phase_time[phase] += arena.time - last_tick;
+
+    client_destroy(c);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    int seeds = DEFAULT_SEEDS;
+    uint32_t first_seed = 1;
+    double duration = DEFAULT_DURATION_S;
+    const char* json_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) seeds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--first-seed") == 0 && i + 1 < argc) first_seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else if (strcmp(argv[i], "--zones") == 0 && i + 1 < argc && strcmp(argv[i + 1], "painted") == 0) {
+            zone_layout = ZONES_PAINTED;
+            i++;
+        } else if (strcmp(argv[i], "--zones") == 0 && i + 1 < argc && strcmp(argv[i + 1], "branches") == 0) {
+            zone_layout = ZONES_BRANCHES;
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [--seeds N] [--first-seed S] [--duration S] [--zones painted|branches] "
+                            "[--json FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (seeds < 1) seeds = 1;
+    if (duration <= 0) duration = DEFAULT_DURATION_S;
+    FaultConfig faults;
+    bool faulty = fault_config_from_env(&faults);
+
+    // The controllers record telemetry every tick
+    if (!telemetry_init(&telemetry, TELEMETRY_DEFAULT_CAPACITY)) {
+        fprintf(stderr, "Allocation failed\n");
+        return 1;
+    }
+
+    // Controller messages stay off the measurement
+    char* stdout_buffer = (char*)malloc(1 << 20);
+    if (stdout_buffer) setvbuf(stdout, stdout_buffer, _IOFBF, 1 << 20);
+
+    ArenaSim* results = (ArenaSim*)calloc((size_t)seeds, sizeof(ArenaSim));
+    LatencyLog latency;
+    memset(&latency, 0, sizeof(latency));
+    if (!results) {
+        fprintf(stderr, "Allocation failed\n");
+        return 1;
+    }
+    for (int i = 0; i < seeds; i++) {
+        if (!run_seed(first_seed + (uint32_t)i, duration, &faults, &latency)) {
+            fprintf(stderr, "Client setup failed\n");
+            return 1;
+        }
+        results[i] = arena;
+    }
+    fflush(stdout);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    // Totals over all seeds
+    unsigned long sorted = 0, correct = 0, picks_failed = 0;
+    double phase_time[PHASE_COUNT] = {0};
+    FaultInjector injected;
+    fault_injector_init(&injected, &faults);
+    for (int i = 0; i < seeds; i++) {
+        sorted += results[i].sorted;
+        correct += results[i].correct;
+        picks_failed += results[i].picks_failed;
+        for (int p = 0; p < PHASE_COUNT; p++) phase_time[p] += results[i].phase_time[p];
+        const FaultStats* f = &results[i].link.stats;
+        injected.stats.lines += f->lines;
+        injected.stats.dropped += f->dropped;
+        injected.stats.commands_dropped += f->commands_dropped;
+        injected.stats.reordered += f->reordered;
+        injected.stats.truncated += f->truncated;
+        injected.stats.overlong += f->overlong;
+        injected.stats.split += f->split;
+        injected.stats.perturbed += f->perturbed;
+        injected.stats.overflowed += f->overflowed;
+        if (f->max_delay_s > injected.stats.max_delay_s) injected.stats.max_delay_s = f->max_delay_s;
+    }
+    double minutes = seeds * duration / 60.0;
+    double total_time = seeds * duration;
+    double missort_rate = sorted ? (double)(sorted - correct) / sorted : 0;
+    qsort(latency.data, latency.count, sizeof(double), compare_doubles);
+    double p50 = percentile(&latency, 0.50) * 1e9;
+    double p99 = percentile(&latency, 0.99) * 1e9;
+    double max = percentile(&latency, 1.0) * 1e9;
+
+    printf("\nArena: %s, %d seeds from %u, %.0f s each, %s zones\n", CONTROLLER_NAME, seeds, first_seed, duration,
+           zone_layout_names[zone_layout]);
+    if (faulty) {
+        fault_config_print(&faults, "  faults");
+        fault_injector_report(&injected, "  injected");
+    }
+    printf("  seed  sorted  correct  failed picks\n");
+    for (int i = 0; i < seeds; i++) {
+        printf("  %4u  %6lu  %7lu  %12lu\n", first_seed + (uint32_t)i, results[i].sorted, results[i].correct,
+               results[i].picks_failed);
+    }
+    printf("  boxes/min           %12.2f\n", sorted / minutes);
+    printf("  correct boxes/min   %12.2f\n", correct / minutes);
+    printf("  mis-sort rate       %11.1f%%\n", 100.0 * missort_rate);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        printf("  time %-14s %11.1f%%\n", phase_names[p], 100.0 * phase_time[p] / total_time);
+    }
+    printf("  control step p50    %9.1f ns\n", p50);
+    printf("  control step p99    %9.1f ns\n", p99);
+    printf("  control step max    %9.1f ns\n", max);
+
+    if (json_path) {
+        FILE* fp = fopen(json_path, "w");
+        if (!fp) {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            return 1;
+        }
+        fprintf(fp, "{\n  \"controller\": \"%s\",\n  \"zones\": \"%s\",\n  \"seeds\": %d,\n  \"first_seed\": %u,\n"
+                    "  \"duration_s\": %.1f,\n",
+                CONTROLLER_NAME, zone_layout_names[zone_layout], seeds, first_seed, duration);
+        fprintf(fp, "  \"boxes_sorted\": %lu,\n  \"boxes_correct\": %lu,\n  \"picks_failed\": %lu,\n"
+                    "  \"boxes_per_min\": %.3f,\n  \"correct_per_min\": %.3f,\n  \"missort_rate\": %.4f,\n",
+                sorted, correct, picks_failed, sorted / minutes, correct / minutes, missort_rate);
+        fprintf(fp, "  \"time_share\": {");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(fp, "%s\"%s\": %.4f", p ? ", " : "", phase_names[p], phase_time[p] / total_time);
+        }
+        fprintf(fp, "},\n  \"step_p50_ns\": %.1f,\n  \"step_p99_ns\": %.1f,\n  \"step_max_ns\": %.1f,\n",
+                p50, p99, max);
+        if (faulty) {
+            const FaultStats* f = &injected.stats;
+            fprintf(fp, "  \"faults\": {\"seed\": %llu, \"latency_ms\": %.1f, \"jitter_ms\": %.1f, \"reorder\": %.4f, "
+                        "\"drop\": %.4f, \"truncate\": %.4f, \"overlong\": %.4f, \"split\": %.4f, "
+                        "\"line_noise\": %.4f, \"line_bias\": %.4f, \"proximity_noise\": %.4f, "
+                        "\"proximity_bias\": %.4f, \"color_noise\": %.4f, \"command_drop\": %.4f},\n",
+                    (unsigned long long)faults.seed, faults.latency_ms, faults.jitter_ms, faults.reorder_rate,
+                    faults.drop_rate, faults.truncate_rate, faults.overlong_rate, faults.split_rate, faults.line_noise,
+                    faults.line_bias, faults.proximity_noise, faults.proximity_bias, faults.color_noise,
+                    faults.command_drop_rate);
+            fprintf(fp, "  \"injected\": {\"lines\": %lu, \"dropped\": %lu, \"commands_dropped\": %lu, "
+                        "\"reordered\": %lu, \"truncated\": %lu, \"overlong\": %lu, \"split\": %lu, "
+                        "\"perturbed\": %lu, \"overflowed\": %lu, \"max_delay_ms\": %.1f},\n",
+                    f->lines, f->dropped, f->commands_dropped, f->reordered, f->truncated, f->overlong, f->split,
+                    f->perturbed, f->overflowed, f->max_delay_s * 1000.0);
+        }
+        fprintf(fp, "  \"per_seed\": [\n");
+        for (int i = 0; i < seeds; i++) {
+            fprintf(fp, "    {\"seed\": %u, \"sorted\": %lu, \"correct\": %lu, \"picks_failed\": %lu}%s\n",
+                    first_seed + (uint32_t)i, results[i].sorted, results[i].correct, results[i].picks_failed,
+                    i + 1 < seeds ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        fclose(fp);
+    }
+
+    free(latency.data);
+    free(results);
+    telemetry_destroy(&telemetry);
+    return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * cyclictest-style jitter benchmark of the Task 2A control loop.
+ *
+ * Runs control_step() on a thread paced by the same absolute-deadline cycle
+ * timer as control_loop, while a feeder thread streams synthetic sensor lines
+ * into the client the way the receive thread does. Reports the wake-up
+ * latency (actual minus planned tick start) and the step time, optionally
+ * with the thread pinned, under SCHED_FIFO/SCHED_DEADLINE, with memory
+ * locked and with busy threads loading the host.
+ *
+ *   ./bench_jitter [--duration S] [--period MS] [--cpu N] [--fifo PRIO]
+ *                  [--deadline RUNTIME_US] [--mlock] [--prefault]
+ *                  [--load THREADS] [--json FILE]
+ *
+ * --period 0 (the default) keeps the controller's own per-state periods.
+ * Unspecified settings fall back to CB_RT_CONTROL_* / CB_RT_MLOCK.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../coppeliasim_client.h"
+#include "../telemetry.h"
+#include "../rt_thread.h"
+#include "../clock_util.h"
+
+#define DEFAULT_DURATION_S 10.0
+#define FEED_PERIOD_MS 5
+#define MAX_LOAD_THREADS 64
+
+// Controller under test (Task2a.c built with TASK2A_NO_MAIN)
+void init_controller(void);
+int control_step(SocketClient* c);
+extern TelemetryStore telemetry;
+extern Watchdog watchdog;
+
+static volatile int stop_flag = 0;
+static SocketClient* client;
+static RtThreadConfig control_cfg;
+static RtCycleTimer timer;
+static int forced_period_ms = 0;
+static double max_step = 0;
+
+#ifdef _WIN32
+    typedef HANDLE BenchThread;
+    #define THREAD_RETURN DWORD WINAPI
+    #define THREAD_ARG LPVOID
+#else
+    typedef pthread_t BenchThread;
+    #define THREAD_RETURN void*
+    #define THREAD_ARG void*
+#endif
+
+static BenchThread start_thread(THREAD_RETURN (*fn)(THREAD_ARG), void* arg) {
+    BenchThread t;
+#ifdef _WIN32
+    t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+#else
+    pthread_create(&t, NULL, fn, arg);
+#endif
+    return t;
+}
+
+static void join_thread(BenchThread t) {
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+}
+
+// Stands in for the receive thread: a sensor line every FEED_PERIOD_MS
+static THREAD_RETURN feeder(THREAD_ARG arg) {
+    (void)arg;
+    char line[128];
+    unsigned long i = 0;
+    while (!stop_flag) {
+        float offset = 1.5f * sinf(i * 0.05f);
+        float ir[5];
+        for (int k = 0; k < 5; k++) {
+            float d = (float)(k - 2) - offset;
+            ir[k] = 1.0f - expf(-d * d);
+        }
+        float proximity = (i % 400) < 40 ? 0.6f - (i % 400) * 0.012f : 1.0f;
+        int n = snprintf(line, sizeof(line), "S:%.3f,%.3f,%.3f,%.3f,%.3f;P:%.4f;C:0.850,0.100,0.100\n",
+                         ir[0], ir[1], ir[2], ir[3], ir[4], proximity);
+        client_feed(client, line, n);
+        i++;
+        SLEEP(FEED_PERIOD_MS);
+    }
+    return 0;
+}
+
+// Busy thread competing for CPU time
+static THREAD_RETURN burner(THREAD_ARG arg) {
+    (void)arg;
+    volatile double x = 0;
+    while (!stop_flag) x += 1.0;
+    return 0;
+}
+
+static THREAD_RETURN control_thread(THREAD_ARG arg) {
+    (void)arg;
+    rt_thread_apply(&control_cfg, "control");
+    rt_cycle_start(&timer);
+    while (!stop_flag) {
+        double t0 = monotonic_seconds();
+        int period = control_step(client);
+        double step = monotonic_seconds() - t0;
+        if (step > max_step) max_step = step;
+        rt_cycle_wait(&timer, forced_period_ms > 0 ? forced_period_ms : period);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    double duration = DEFAULT_DURATION_S;
+    int load_threads = 0;
+    int mlock = 0;
+    const char* json_path = NULL;
+
+    rt_thread_config_from_env(&control_cfg, "CONTROL");
+    const char* env_mlock = getenv("CB_RT_MLOCK");
+    if (env_mlock && atoi(env_mlock) != 0) mlock = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) duration = atof(argv[++i]);
+        else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) forced_period_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) control_cfg.cpu = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fifo") == 0 && i + 1 < argc) {
+            control_cfg.policy = RT_POLICY_FIFO;
+            control_cfg.priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--deadline") == 0 && i + 1 < argc) {
+            control_cfg.policy = RT_POLICY_DEADLINE;
+            control_cfg.runtime_us = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--mlock") == 0) mlock = 1;
+        else if (strcmp(argv[i], "--prefault") == 0) control_cfg.prefault_stack = true;
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) load_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--duration S] [--period MS] [--cpu N] [--fifo PRIO] [--deadline RUNTIME_US]\n"
+                            "       [--mlock] [--prefault] [--load THREADS] [--json FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (load_threads > MAX_LOAD_THREADS) load_threads = MAX_LOAD_THREADS;
+    if (control_cfg.policy == RT_POLICY_DEADLINE && control_cfg.period_us == 0) {
+        control_cfg.period_us = (uint64_t)(forced_period_ms > 0 ? forced_period_ms : 50) * 1000;
+    }
+
+    if (mlock) rt_lock_memory();
+
+    ClientConfig config;
+    client_config_init(&config);
+    config.transport = &null_transport;
+    config.pick_assumed_ms = 0;  // Nothing answers PICK/DROP here
+    config.drop_assumed_ms = 0;
+    init_controller();
+    watchdog_init(&watchdog, WATCHDOG_FRAME_PERIOD_MS, 0);
+    config.watchdog = &watchdog;
+    client = client_create(&config);
+    if (!client || !client_open(client) || !telemetry_init(&telemetry, TELEMETRY_DEFAULT_CAPACITY)) {
+        fprintf(stderr, "Client setup failed\n");
+        return 1;
+    }
+
+    // The controller prints state transitions; keep them off the measurement
+    char* stdout_buffer = (char*)malloc(1 << 20);
+    if (stdout_buffer) setvbuf(stdout, stdout_buffer, _IOFBF, 1 << 20);
+
+    BenchThread load[MAX_LOAD_THREADS];
+    for (int i = 0; i < load_threads; i++) load[i] = start_thread(burner, NULL);
+    BenchThread feed = start_thread(feeder, NULL);
+    SLEEP(20);  // First sensor lines before the controller starts
+    BenchThread control = start_thread(control_thread, NULL);
+
+    SLEEP((int)(duration * 1000));
+    stop_flag = 1;
+    join_thread(control);
+    join_thread(feed);
+    for (int i = 0; i < load_threads; i++) join_thread(load[i]);
+    fflush(stdout);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    const char* policy = control_cfg.policy == RT_POLICY_FIFO ? "fifo"
+                       : control_cfg.policy == RT_POLICY_DEADLINE ? "deadline" : "other";
+    printf("\nControl loop jitter: %.0f s, period %s, cpu %d, policy %s, mlock %s, %d load threads\n",
+           duration, forced_period_ms > 0 ? "forced" : "per state", control_cfg.cpu, policy,
+           mlock ? "on" : "off", load_threads);
+    rt_cycle_report(&timer, "  wake-up");
+    printf("  step time max %.0f us\n", max_step * 1e6);
+
+    if (json_path) {
+        FILE* fp = fopen(json_path, "w");
+        if (!fp) {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            return 1;
+        }
+        double avg = timer.cycles ? timer.total_latency / timer.cycles : 0;
+        fprintf(fp, "{\n  \"duration_s\": %.1f,\n  \"cpu\": %d,\n  \"policy\": \"%s\",\n  \"mlock\": %d,\n"
+                    "  \"load_threads\": %d,\n  \"cycles\": %llu,\n  \"overruns\": %llu,\n",
+                duration, control_cfg.cpu, policy, mlock, load_threads,
+                (unsigned long long)timer.cycles, (unsigned long long)timer.overruns);
+        fprintf(fp, "  \"latency_min_us\": %.1f,\n  \"latency_avg_us\": %.1f,\n  \"latency_p99_us\": %.1f,\n"
+                    "  \"latency_max_us\": %.1f,\n  \"step_max_us\": %.1f\n}\n",
+                timer.cycles ? timer.min_latency * 1e6 : 0, avg * 1e6, rt_cycle_percentile(&timer, 0.99) * 1e6,
+                timer.max_latency * 1e6, max_step * 1e6);
+        fclose(fp);
+    }
+
+    telemetry_destroy(&telemetry);
+    client_destroy(client);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Microbenchmarks of the per-frame hot path: sensor line parsing, the PID
+ * step, the line and color classifiers, telemetry recording, and the live
+ * metrics (per-tick update and one scrape).
+ */
+#include <stdio.h>
+#include <string.h>
+#include "microbench.h"
+#include "../coppeliasim_client.h"
+#include "../sensor_kernels.h"
+#include "../telemetry.h"
+#include "../metrics.h"
+
+#define SAMPLE_COUNT 64  // Power of two
+
+static float ir_samples[SAMPLE_COUNT][5];
+static float rgb_samples[SAMPLE_COUNT][3];
+
+static void init_samples(void) {
+    srand(7);
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        for (int k = 0; k < 5; k++) ir_samples[i][k] = (float)rand() / RAND_MAX;
+        for (int k = 0; k < 3; k++) rgb_samples[i][k] = (float)rand() / RAND_MAX;
+    }
+}
+
+static void bm_parse_sensor_line(long iterations) {
+    static const char line[] = "S:0.912,0.143,0.087,0.150,0.903;P:0.4521;C:0.812,0.104,0.097";
+    char buffer[sizeof(line)];
+    SensorFrame frame;
+    for (long i = 0; i < iterations; i++) {
+        memcpy(buffer, line, sizeof(line));  // Parsing is in place
+        parse_sensor_line(buffer, &frame);
+        DO_NOT_OPTIMIZE(frame);
+    }
+}
+
+static void bm_centroid_pid(long iterations) {
+    PidState pid = {0, 0};
+    const PidGains gains = {1.2f, 0.0f, 0.5f};
+    for (long i = 0; i < iterations; i++) {
+        float error = line_centroid_error(ir_samples[i & (SAMPLE_COUNT - 1)]);
+        float corr = pid_step(&pid, &gains, error);
+        DO_NOT_OPTIMIZE(corr);
+    }
+}
+
+static void bm_classify_line(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        const float* ir = ir_samples[i & (SAMPLE_COUNT - 1)];
+        int cls = (int)classify_line(ir) + is_node_pattern(ir);
+        DO_NOT_OPTIMIZE(cls);
+    }
+}
+
+static void bm_classify_color(long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        const float* rgb = rgb_samples[i & (SAMPLE_COUNT - 1)];
+        char color = classify_color(rgb[0], rgb[1], rgb[2]);
+        DO_NOT_OPTIMIZE(color);
+    }
+}
+
+static void bm_telemetry_record(long iterations) {
+    static TelemetryStore store;
+    if (!store.capacity) telemetry_init(&store, 4096);
+    TelemetrySample s;
+    memset(&s, 0, sizeof(s));
+    for (long i = 0; i < iterations; i++) {
+        s.timestamp = (double)i;
+        s.state = (int32_t)(i & 7);
+        telemetry_record(&store, &s);
+        CLOBBER_MEMORY();
+    }
+}
+
+static const char* const metric_states[] = {"SEARCHING", "APPROACHING", "PICKING", "NAVIGATING_TO_NODE",
+                                             "AT_NODE", "NAVIGATING_TO_DROP", "DROPPING"};
+
+static void bm_metrics_record(long iterations) {
+    static ControlMetrics m;
+    metrics_init(&m, metric_states, 7);
+    for (long i = 0; i < iterations; i++) {
+        metrics_record_tick(&m, 1.0 + i * 0.02, (int)((i >> 6) % 7), (i & 3) != 0,
+                            ir_samples[i & (SAMPLE_COUNT - 1)][0] - 0.5f);
+        CLOBBER_MEMORY();
+    }
+}
+
+static void bm_metrics_scrape(long iterations) {
+    static ControlMetrics m;
+    static ClientStats stats;
+    static char buffer[METRICS_RESPONSE_SIZE];
+    metrics_init(&m, metric_states, 7);
+    for (int i = 0; i < 1000; i++) metrics_record_tick(&m, 1.0 + i * 0.02, i % 7, true, 0.1f);
+    for (long i = 0; i < iterations; i++) {
+        size_t n = metrics_render_prometheus(&m, &stats, 30.0, buffer, sizeof(buffer));
+        DO_NOT_OPTIMIZE(n);
+    }
+}
+
+int main(int argc, char** argv) {
+    static const Microbench benches[] = {
+        {"BM_ParseSensorLine", bm_parse_sensor_line},
+        {"BM_CentroidPid", bm_centroid_pid},
+        {"BM_ClassifyLine", bm_classify_line},
+        {"BM_ClassifyColor", bm_classify_color},
+        {"BM_TelemetryRecord", bm_telemetry_record},
+        {"BM_MetricsRecord", bm_metrics_record},
+        {"BM_MetricsScrape", bm_metrics_scrape},
+    };
+    init_samples();
+    return microbench_main(argc, argv, benches, (int)(sizeof(benches) / sizeof(benches[0])));
+}
@@ -0,0 +1,391 @@
+/*
+ * Replay benchmark: drives the Task 2A controller from a sensor trace.
+ *
+ * Every sensor line goes through client_feed() (line assembly and parsing,
+ * exactly as in the receive thread) followed by one control_step() of the
+ * state machine, with no socket and no sleeps. Reports frames per second for
+ * the whole pipeline and the control-step latency distribution. This is also
+ * the training workload for profile-guided builds (tools/pgo.sh).
+ *
+ * On glibc the replay also counts heap allocations made while it runs and
+ * fails (exit status 3) if there is any: the steady-state path must not
+ * allocate.
+ *
+ *   ./bench_replay [--trace BASE.in [--state NAME [--nth N] | --from S]]
+ *                  [--synthetic FRAMES] [--passes N] [--json FILE]
+ *
+ * --trace replays the `.in` recording written with CB_RECORDING=BASE
+ * (i.e. pass BASE.in); without it a deterministic synthetic trace of
+ * pick/node/drop cycles is generated. --state starts the replay at the Nth
+ * (default first) entry into a Task 2A state, e.g. --state DROPPING --nth 3;
+ * --from starts it S seconds into the recording. Both seek through the
+ * recording's index; the controller starts from its initial state there.
+ * --json also writes the results to FILE; stdout carries the controller's own
+ * state-transition messages.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../coppeliasim_client.h"
+#include "../telemetry.h"
+#include "../recording.h"
+#include "../clock_util.h"
+#include "../adaptive_rate.h"
+#include "../state_estimator.h"
+#include "../line_recovery.h"
+
+#define DEFAULT_SYNTHETIC_FRAMES 20000
+#define DEFAULT_PASSES 3
+#define TRACE_LINE_MAX 128
+
+// Heap allocations are counted by wrapping glibc's allocator; the sanitizers bring their own
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define COUNT_ALLOCATIONS 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static int counting_allocations = 0;
+static unsigned long heap_allocations = 0;
+
+void* malloc(size_t size) {
+    if (counting_allocations) heap_allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (counting_allocations) heap_allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (counting_allocations) heap_allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+#else
+#define COUNT_ALLOCATIONS 0
+static int counting_allocations = 0;
+static unsigned long heap_allocations = 0;
+#endif
+
+// Controller under test (Task2a.c built with TASK2A_NO_MAIN)
+void init_controller(void);
+int control_step(SocketClient* c);
+const char* controller_state_name(int state);
+extern TelemetryStore telemetry;
+extern Watchdog watchdog;
+extern AdaptiveRate control_rate;
+extern StateEstimator estimator;
+extern unsigned long box_lost_events;
+extern LineRecovery line_recovery;
+
+// All lines of a trace, newline-terminated, in one buffer
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t* line_end;                   // Offset just past each line's newline
+    size_t count;
+    size_t line_capacity;
+} Trace;
+
+static int trace_append(Trace* t, const char* line, size_t length) {
+    if (t->size + length + 1 > t->capacity) {
+        size_t cap = t->capacity ? t->capacity * 2 : 1 << 20;
+        while (cap < t->size + length + 1) cap *= 2;
+        char* data = (char*)realloc(t->data, cap);
+        if (!data) return 0;
+        t->data = data;
+        t->capacity = cap;
+    }
+    if (t->count == t->line_capacity) {
+        size_t cap = t->line_capacity ? t->line_capacity * 2 : 4096;
+        size_t* ends = (size_t*)realloc(t->line_end, cap * sizeof(size_t));
+        if (!ends) return 0;
+        t->line_end = ends;
+        t->line_capacity = cap;
+    }
+    memcpy(t->data + t->size, line, length);
+    t->size += length;
+    t->data[t->size++] = '\n';
+    t->line_end[t->count++] = t->size;
+    return 1;
+}
+
+static void trace_free(Trace* t) {
+    free(t->data);
+    free(t->line_end);
+    memset(t, 0, sizeof(*t));
+}
+
+// Where in a recording the replay starts
+typedef struct {
+    int state;                          // Start at an entry into this state (-1 = not by state)
+    uint32_t nth;                       // 1-based entry into that state
+    double from_s;                      // Otherwise start this many seconds in
+} TraceStart;
+
+/**
+ * @brief Positions a reader where the replay starts
+ * @param start_time Receives the timestamp before which records are skipped
+ * @return 1 on success, 0 if the state entry does not exist
+ */
+static int seek_recorded_trace(RecordingReader* rd, const TraceStart* start, double* start_time) {
+    *start_time = 0;
+    if (start->state >= 0) {
+        const RecordingIndexEntry* e = recording_find_state(rd, start->state, start->nth);
+        return e && recording_seek(rd, e);
+    }
+    if (start->from_s > 0 && rd->entry_count > 0) {
+        // The first index entry points at the first record
+        *start_time = rd->entries[0].timestamp + start->from_s;
+        const RecordingIndexEntry* e = recording_find_time(rd, *start_time);
+        if (e) return recording_seek(rd, e);
+    }
+    return recording_rewind(rd);
+}
+
+/**
+ * @brief Loads the sensor lines of a recording from the requested start on
+ * @return Number of lines loaded, 0 if the recording could not be read
+ */
+static size_t load_recorded_trace(Trace* t, const char* base, const TraceStart* start) {
+    RecordingReader rd;
+    RecordingRecord rec;
+    double start_time;
+    if (!recording_reader_open(&rd, base)) return 0;
+    if (seek_recorded_trace(&rd, start, &start_time)) {
+        while (recording_next(&rd, &rec)) {
+            if (rec.type != REC_SENSOR_LINE || rec.timestamp < start_time) continue;
+            if (!trace_append(t, (const char*)rec.payload, rec.length)) break;
+        }
+    }
+    recording_reader_close(&rd);
+    return t->count;
+}
+
+// Small deterministic generator so traces are identical on every platform
+static uint32_t trace_rng = 12345;
+
+static float noise(float amplitude) {
+    trace_rng = trace_rng * 1664525u + 1013904223u;
+    return ((float)(trace_rng >> 8) / 16777216.0f - 0.5f) * 2.0f * amplitude;
+}
+
+static float clamp01(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+/**
+ * @brief Appends one sensor line for a line at lateral position `offset` (sensor pitch units)
+ */
+static int append_frame(Trace* t, float offset, int lost, float proximity, const float rgb[3]) {
+    char line[TRACE_LINE_MAX];
+    float ir[5];
+    for (int k = 0; k < 5; k++) {
+        float d = (float)(k - 2) - offset;
+        ir[k] = lost ? 0.9f + noise(0.05f) : clamp01(1.0f - expf(-d * d) + noise(0.05f));
+    }
+    int n = snprintf(line, sizeof(line), "S:%.3f,%.3f,%.3f,%.3f,%.3f;P:%.4f;C:%.3f,%.3f,%.3f",
+                     ir[0], ir[1], ir[2], ir[3], ir[4], proximity,
+                     clamp01(rgb[0] + noise(0.03f)), clamp01(rgb[1] + noise(0.03f)), clamp01(rgb[2] + noise(0.03f)));
+    return trace_append(t, line, (size_t)n);
+}
+
+/**
+ * @brief Generates repeated pick -> node -> drop cycles
+ *
+ * Each cycle: line following with a wandering line, occasional lost-line
+ * frames and single-frame proximity glitches, a noisy box approach with the
+ * box color visible ending at rest in front of the box, more line following,
+ * the all-black Node N1 pattern, then the run to the drop zone.
+ */
+static size_t generate_synthetic_trace(Trace* t, size_t frames) {
+    static const float floor_rgb[3] = {0.5f, 0.5f, 0.5f};
+    static const float box_rgb[3][3] = {{0.85f, 0.1f, 0.1f}, {0.1f, 0.85f, 0.1f}, {0.1f, 0.1f, 0.85f}};
+    size_t cycle = 0;
+
+    while (t->count < frames) {
+        const float* rgb = box_rgb[cycle % 3];
+        float phase = (float)cycle;
+
+        for (int i = 0; i < 150; i++) {
+            float offset = 1.6f * sinf(phase + i * 0.07f);
+            float proximity = i % 53 == 52 ? 0.45f : 1.0f;  // Single-frame proximity glitch
+            if (!append_frame(t, offset, i % 37 == 36, proximity, floor_rgb)) return t->count;
+        }
+        for (int i = 0; i < 75; i++) {
+            // Decelerates into the pick pose and rests there; noise grows with distance
+            float remaining = i < 60 ? 1.0f - i / 60.0f : 0.0f;
+            float proximity = 0.17f + 0.43f * remaining * remaining;
+            proximity += noise(0.06f * proximity);
+            if (!append_frame(t, noise(0.3f), 0, proximity, proximity < 0.5f ? rgb : floor_rgb)) return t->count;
+        }
+        for (int i = 0; i < 100; i++) {
+            if (!append_frame(t, 1.2f * sinf(phase + i * 0.11f), 0, 1.0f, floor_rgb)) return t->count;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (!append_frame(t, 0.0f, 0, 1.0f, floor_rgb)) return t->count;
+            // Overwrite the IR part with the node pattern: every sensor on the line
+            char* line = t->data + (t->count > 1 ? t->line_end[t->count - 2] : 0);
+            memcpy(line, "S:0.050,0.050,0.050,0.050,0.050", 31);
+        }
+        for (int i = 0; i < 80; i++) {
+            if (!append_frame(t, 0.8f * sinf(phase + i * 0.13f), 0, 1.0f, floor_rgb)) return t->count;
+        }
+        cycle++;
+    }
+    return t->count;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    const char* trace_path = NULL;
+    size_t synthetic_frames = DEFAULT_SYNTHETIC_FRAMES;
+    int passes = DEFAULT_PASSES;
+    const char* json_path = NULL;
+    const char* state_name = NULL;
+    TraceStart trace_start = {-1, 1, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) state_name = argv[++i];
+        else if (strcmp(argv[i], "--nth") == 0 && i + 1 < argc) trace_start.nth = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) trace_start.from_s = atof(argv[++i]);
+        else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) synthetic_frames = (size_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) passes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--trace BASE.in [--state NAME [--nth N] | --from S]] [--synthetic FRAMES] "
+                            "[--passes N] [--json FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (passes < 1) passes = 1;
+    if (state_name) {
+        for (int s = 0; controller_state_name(s); s++) {
+            if (strcmp(controller_state_name(s), state_name) == 0) trace_start.state = s;
+        }
+        if (trace_start.state < 0) {
+            fprintf(stderr, "Unknown state %s\n", state_name);
+            return 2;
+        }
+    }
+
+    Trace trace;
+    memset(&trace, 0, sizeof(trace));
+    size_t frames = trace_path ? load_recorded_trace(&trace, trace_path, &trace_start)
+                               : generate_synthetic_trace(&trace, synthetic_frames);
+    if (frames == 0) {
+        if (state_name) fprintf(stderr, "No sensor lines after entry %u into %s in %s\n", trace_start.nth, state_name, trace_path);
+        else fprintf(stderr, "No sensor lines in %s\n", trace_path ? trace_path : "synthetic trace");
+        return 1;
+    }
+
+    ClientConfig config;
+    client_config_init(&config);
+    config.transport = &null_transport;
+    config.pick_assumed_ms = 0;  // Nothing answers PICK/DROP here and control time is not wall time
+    config.drop_assumed_ms = 0;
+    config.motor_refresh_ms = 0;  // Coalescing runs on wall time, which is not replay time
+    init_controller();
+    watchdog_init(&watchdog, WATCHDOG_FRAME_PERIOD_MS, 0);
+    config.watchdog = &watchdog;
+
+    SocketClient* c = client_create(&config);
+    if (!c || !client_open(c) || !telemetry_init(&telemetry, TELEMETRY_DEFAULT_CAPACITY)) {
+        fprintf(stderr, "Allocation failed\n");
+        return 1;
+    }
+
+    // The controller prints state transitions; keep them off the measurement
+    char* stdout_buffer = (char*)malloc(1 << 20);
+    if (stdout_buffer) setvbuf(stdout, stdout_buffer, _IOFBF, 1 << 20);
+
+    double* latency = (double*)malloc(frames * passes * sizeof(double));
+    if (!latency) {
+        fprintf(stderr, "Allocation failed\n");
+        return 1;
+    }
+
+    size_t steps = 0;
+    counting_allocations = 1;
+    double start = monotonic_seconds();
+    for (int pass = 0; pass < passes; pass++) {
+        size_t line_start = 0;
+        for (size_t i = 0; i < frames; i++) {
+            client_feed(c, trace.data + line_start, (int)(trace.line_end[i] - line_start));
+            line_start = trace.line_end[i];
+
+            double t0 = monotonic_seconds();
+            control_step(c);
+            latency[steps++] = monotonic_seconds() - t0;
+        }
+    }
+    double elapsed = monotonic_seconds() - start;
+    counting_allocations = 0;
+    fflush(stdout);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    qsort(latency, steps, sizeof(double), compare_doubles);
+    double p50 = latency[steps / 2] * 1e9;
+    double p99 = latency[(size_t)(steps * 0.99)] * 1e9;
+    double max = latency[steps - 1] * 1e9;
+    double fps = steps / elapsed;
+
+    printf("\nReplayed %zu frames x %d passes (%s)\n", frames, passes, trace_path ? trace_path : "synthetic");
+    printf("  frames/sec          %12.0f\n", fps);
+    printf("  control step p50    %9.1f ns\n", p50);
+    printf("  control step p99    %9.1f ns\n", p99);
+    printf("  control step max    %9.1f ns\n", max);
+    printf("  commands sent       %12lu\n", client_stats(c)->commands_sent);
+    if (COUNT_ALLOCATIONS) printf("  heap allocations    %12lu\n", heap_allocations);
+    adaptive_rate_report(&control_rate, "  control rate");
+    printf("  proximity outliers  %12lu\n", estimator.distance.rejects);
+    printf("  approaches lost     %12lu\n", box_lost_events);
+    double mean_recovery_ms = line_recovery.recoveries ? 1000.0 * line_recovery.total_recovery_s / line_recovery.recoveries : 0;
+    printf("  line losses         %12lu\n", line_recovery.losses);
+    printf("  line recovery mean  %9.1f ms\n", mean_recovery_ms);
+    printf("  line recovery max   %9.1f ms\n", 1000.0 * line_recovery.max_recovery_s);
+
+    if (json_path) {
+        FILE* fp = fopen(json_path, "w");
+        if (!fp) {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            return 1;
+        }
+        fprintf(fp, "{\n  \"trace\": \"%s\",\n  \"frames\": %zu,\n  \"passes\": %d,\n",
+                trace_path ? trace_path : "synthetic", frames, passes);
+        fprintf(fp, "  \"frames_per_sec\": %.0f,\n  \"step_p50_ns\": %.1f,\n  \"step_p99_ns\": %.1f,\n"
+                    "  \"step_max_ns\": %.1f,\n  \"commands_sent\": %lu,\n  \"mean_period_ms\": %.2f,\n"
+                    "  \"proximity_outliers\": %lu,\n  \"approaches_lost\": %lu,\n  \"line_losses\": %lu,\n"
+                    "  \"line_recovery_mean_ms\": %.1f,\n  \"line_recovery_max_ms\": %.1f,\n"
+                    "  \"line_recovery_failures\": %lu\n}\n",
+                fps, p50, p99, max, client_stats(c)->commands_sent,
+                control_rate.ticks ? control_rate.scheduled_ms / control_rate.ticks : 0.0,
+                estimator.distance.rejects, box_lost_events, line_recovery.losses, mean_recovery_ms,
+                1000.0 * line_recovery.max_recovery_s, line_recovery.failures);
+        fclose(fp);
+    }
+
+    free(latency);
+    telemetry_destroy(&telemetry);
+    client_destroy(c);
+    trace_free(&trace);
+
+    if (heap_allocations > 0) {
+        fprintf(stderr, "%lu heap allocations in %zu control steps, expected none\n", heap_allocations, steps);
+        return 3;
+    }
+    return 0;
+}
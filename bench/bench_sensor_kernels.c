@@ -0,0 +1,130 @@
+/*
+ * Benchmark of the batch sensor kernels (sensor_kernels.h).
+ *
+ * Runs every kernel on the scalar, SSE2 and AVX2 paths over the same random
+ * batch, checks that the outputs are bit-identical to the scalar path and
+ * reports the time per element and the speedup over scalar.
+ *
+ *   ./bench_sensor_kernels [robots] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../sensor_kernels.h"
+#include "../clock_util.h"
+
+typedef struct {
+    float* error;
+    float* integral;
+    float* prev_error;
+    float* corr;
+    uint8_t* cls;
+    uint8_t* node;
+    char* color;
+} KernelOutputs;
+
+static void alloc_outputs(KernelOutputs* o, size_t n) {
+    o->error = (float*)calloc(n, sizeof(float));
+    o->integral = (float*)calloc(n, sizeof(float));
+    o->prev_error = (float*)calloc(n, sizeof(float));
+    o->corr = (float*)calloc(n, sizeof(float));
+    o->cls = (uint8_t*)calloc(n, 1);
+    o->node = (uint8_t*)calloc(n, 1);
+    o->color = (char*)calloc(n, 1);
+}
+
+static void free_outputs(KernelOutputs* o) {
+    free(o->error); free(o->integral); free(o->prev_error); free(o->corr);
+    free(o->cls); free(o->node); free(o->color);
+}
+
+// Sensor values cluster around the thresholds so every branch is exercised
+static float random_reading(void) {
+    static const float anchors[] = {0.0f, 0.3f, 0.4f, 0.6f, 0.7f, 1.0f};
+    float base = anchors[rand() % 6];
+    float jitter = ((float)rand() / RAND_MAX - 0.5f) * 0.2f;
+    return (rand() % 8 == 0) ? base : base + jitter;
+}
+
+typedef void (*KernelFn)(const SensorBatch* b, KernelOutputs* o, const PidGains* g);
+
+static void run_centroid(const SensorBatch* b, KernelOutputs* o, const PidGains* g) {
+    (void)g;
+    batch_line_centroid(b, o->error);
+}
+
+static void run_pid(const SensorBatch* b, KernelOutputs* o, const PidGains* g) {
+    batch_pid_step(g, o->integral, o->prev_error, o->error, o->corr, b->count);
+}
+
+static void run_line(const SensorBatch* b, KernelOutputs* o, const PidGains* g) {
+    (void)g;
+    batch_classify_line(b, o->cls, o->node);
+}
+
+static void run_color(const SensorBatch* b, KernelOutputs* o, const PidGains* g) {
+    (void)g;
+    batch_classify_color(b, o->color);
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? (size_t)atol(argv[1]) : 4099;  // Odd size exercises the scalar tail
+    int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+    const PidGains gains = {1.2f, 0.0f, 0.5f};
+
+    srand(42);
+    float* channels[8];
+    for (int k = 0; k < 8; k++) {
+        channels[k] = (float*)malloc(n * sizeof(float));
+        for (size_t i = 0; i < n; i++) channels[k][i] = random_reading();
+    }
+    SensorBatch batch;
+    batch.count = n;
+    for (int k = 0; k < 5; k++) batch.ir[k] = channels[k];
+    batch.color_r = channels[5];
+    batch.color_g = channels[6];
+    batch.color_b = channels[7];
+
+    const char* names[] = {"line_centroid", "pid_step", "classify_line", "classify_color"};
+    KernelFn kernels[] = {run_centroid, run_pid, run_line, run_color};
+    KernelLevel levels[] = {KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2};
+    KernelOutputs out[3];
+    int failures = 0;
+
+    printf("robots=%zu iterations=%d best=%s\n", n, iterations, kernel_level_name(kernel_level_detect()));
+
+    for (int k = 0; k < 4; k++) {
+        double scalar_ns = 0;
+        for (int l = 0; l < 3; l++) {
+            if (kernel_level_set(levels[l]) != levels[l]) continue;
+            alloc_outputs(&out[l], n);
+            // PID consumes the centroid output
+            batch_line_centroid(&batch, out[l].error);
+
+            double start = monotonic_seconds();
+            for (int it = 0; it < iterations; it++) kernels[k](&batch, &out[l], &gains);
+            double ns = (monotonic_seconds() - start) * 1e9 / ((double)iterations * n);
+            if (l == 0) scalar_ns = ns;
+
+            int same = 1;
+            if (l > 0) {
+                same = memcmp(out[l].error, out[0].error, n * sizeof(float)) == 0 &&
+                       memcmp(out[l].integral, out[0].integral, n * sizeof(float)) == 0 &&
+                       memcmp(out[l].corr, out[0].corr, n * sizeof(float)) == 0 &&
+                       memcmp(out[l].cls, out[0].cls, n) == 0 &&
+                       memcmp(out[l].node, out[0].node, n) == 0 &&
+                       memcmp(out[l].color, out[0].color, n) == 0;
+                if (!same) failures++;
+            }
+            printf("%-15s %-7s %8.3f ns/robot  speedup %5.2fx  %s\n", names[k], kernel_level_name(levels[l]),
+                   ns, scalar_ns / ns, same ? "identical" : "MISMATCH");
+        }
+        for (int l = 0; l < 3; l++) {
+            if (out[l].error) free_outputs(&out[l]);
+            memset(&out[l], 0, sizeof(out[l]));
+        }
+    }
+
+    for (int k = 0; k < 8; k++) free(channels[k]);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * Behaviour checks for the controller building blocks, run by ctest.
+ *
+ * Each check drives one header-only module with hand-made inputs and
+ * verifies the property it promises:
+ *   - wheel_shaping.h: the steering difference survives saturation, the
+ *     wheels stay in range and every step respects the slew limit
+ *   - line_recovery.h: the search side comes from the recent line history,
+ *     extrapolated along its trend, and falls back to the previous side;
+ *     a brief loss keeps the controller's command, and past the timeout the
+ *     robot keeps spiralling outwards
+ *   - state_estimator.h: a single outlier is gated, ESTIMATOR_MAX_REJECTS in
+ *     a row restart the distance filter from the sensor
+ *   - recording.h: a recording written with state marks is found again
+ *     through its index, by state entry and by time, and reads on from there
+ *
+ *   ./check_behaviour        exit status 0 if every check passed
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../wheel_shaping.h"
+#include "../line_recovery.h"
+#include "../state_estimator.h"
+#include "../recording.h"
+
+#define EPS 1e-5f
+
+// Checks stay active in release builds, unlike assert()
+static int failures = 0;
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+// Small deterministic generator so every run checks the same commands
+static uint32_t rng = 12345;
+
+static float uniform(float lo, float hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(rng >> 8) / 16777216.0f;
+}
+
+// ==================== Wheel shaping ====================
+
+static void check_wheel_shaper(void) {
+    WheelShaper w;
+
+    // Saturating base speed: both wheels would clip to 1, the difference must survive
+    wheel_shaper_init(&w, 0.0f, 1.0f, 0.0f);
+    float left = 2.6f + 0.3f, right = 2.6f - 0.3f;
+    wheel_shaper_apply(&w, &left, &right, 0.0f, 0.0f, 0.01f);
+    CHECK(fabsf((left - right) - 0.6f) < EPS);
+    CHECK(fabsf(left - 1.0f) < EPS);
+    CHECK(w.saturated == 1 && w.clipped == 0);
+
+    // Difference wider than the range: clipped to the range, still turning the same way
+    left = 2.0f;
+    right = -1.0f;
+    wheel_shaper_apply(&w, &left, &right, 0.0f, 0.0f, 0.01f);
+    CHECK(fabsf(left - 1.0f) < EPS && fabsf(right) < EPS);
+    CHECK(w.clipped == 1);
+
+    // With the slew limit on, a steady saturating command settles on the same difference
+    wheel_shaper_init(&w, 0.0f, 1.0f, 8.0f);
+    float prev_left = 0.0f, prev_right = 0.0f;
+    for (int i = 0; i < 200; i++) {
+        left = 2.6f - 0.25f;
+        right = 2.6f + 0.25f;
+        wheel_shaper_apply(&w, &left, &right, prev_left, prev_right, 0.005f);
+        prev_left = left;
+        prev_right = right;
+    }
+    CHECK(fabsf((right - left) - 0.5f) < EPS);
+    CHECK(fabsf(right - 1.0f) < EPS);
+
+    // Random commands: always in range, and no wheel moves faster than the slew limit allows
+    // (common mode and half difference each by slew * dt)
+    wheel_shaper_init(&w, 0.0f, 1.0f, 8.0f);
+    prev_left = prev_right = 0.0f;
+    int bad_range = 0, bad_slew = 0;
+    for (int i = 0; i < 10000; i++) {
+        float dt = uniform(0.001f, 0.05f);
+        float step = w.slew * dt;
+        left = uniform(-1.0f, 4.0f);
+        right = uniform(-1.0f, 4.0f);
+        wheel_shaper_apply(&w, &left, &right, prev_left, prev_right, dt);
+        if (left < -EPS || left > 1.0f + EPS || right < -EPS || right > 1.0f + EPS) bad_range++;
+        float mean_step = 0.5f * ((left + right) - (prev_left + prev_right));
+        float diff_step = (left - right) - (prev_left - prev_right);
+        if (fabsf(mean_step) > step + EPS || fabsf(diff_step) > 2 * step + EPS) bad_slew++;
+        prev_left = left;
+        prev_right = right;
+    }
+    CHECK(bad_range == 0);
+    CHECK(bad_slew == 0);
+}
+
+// ==================== Line recovery ====================
+
+/**
+ * @brief Tracks positions from first to last over duration seconds, ending at now
+ */
+static void observe_ramp(LineRecovery* r, float first, float last, double duration, double now) {
+    const int n = LINE_RECOVERY_HISTORY;
+    for (int i = 0; i < n; i++) {
+        double t = now - duration + duration * i / (n - 1);
+        line_recovery_observe(r, true, first + (last - first) * i / (n - 1), t);
+    }
+}
+
+static void check_line_recovery(void) {
+    LineRecovery r;
+    float left, right;
+
+    // Line last seen to the right: search right, the left wheel is the outer one.
+    // Within the grace period the controller's own command is left alone.
+    line_recovery_init(&r);
+    observe_ramp(&r, 0.5f, 1.0f, 0.2, 10.0);
+    left = 0.9f;
+    right = 0.1f;
+    line_recovery_steer(&r, 10.05, 0.6f, 0.4f, &left, &right);
+    CHECK(r.side == 1 && r.guessed_sides == 0);
+    CHECK(left == 0.9f && right == 0.1f);
+    line_recovery_steer(&r, 10.45, 0.6f, 0.4f, &left, &right);
+    CHECK(left > right);
+
+    // Line last seen to the left: search left
+    line_recovery_observe(&r, true, -0.2f, 11.0);  // Ends the episode
+    observe_ramp(&r, -0.5f, -1.0f, 0.2, 12.0);
+    line_recovery_steer(&r, 12.05, 0.6f, 0.4f, &left, &right);
+    CHECK(r.side == -1);
+    line_recovery_steer(&r, 12.45, 0.6f, 0.4f, &left, &right);
+    CHECK(right > left);
+
+    // Still left of center but moving right fast: the trend wins over the last position
+    line_recovery_observe(&r, true, 0.0f, 13.0);
+    observe_ramp(&r, -0.5f, -0.05f, 0.1, 14.0);
+    line_recovery_steer(&r, 14.02, 0.6f, 0.4f, &left, &right);
+    CHECK(r.side == 1);
+
+    // History older than LINE_RECOVERY_MEMORY_S says nothing: keep the previous side
+    line_recovery_observe(&r, true, 0.0f, 15.0);
+    observe_ramp(&r, -0.8f, -0.9f, 0.2, 16.0);
+    unsigned long guessed = r.guessed_sides;
+    line_recovery_steer(&r, 16.0 + LINE_RECOVERY_MEMORY_S + 0.5, 0.6f, 0.4f, &left, &right);
+    CHECK(r.side == 1);
+    CHECK(r.guessed_sides == guessed + 1);
+
+    // Past the timeout the loss counts as a failure, but the robot keeps moving
+    // forward on a widening spiral towards the same side instead of parking
+    double lost = r.lost_since;
+    unsigned long failures = r.failures;
+    float last_inner = -1.0f;
+    int stopped = 0, narrowing = 0;
+    for (double t = r.timeout_s + 0.01; t < r.timeout_s + 30.0; t += 0.5) {
+        CHECK(line_recovery_steer(&r, lost + t, 0.6f, 0.4f, &left, &right) == RECOVERY_SPIRAL);
+        if (left <= 0.0f || right < 0.0f) stopped++;
+        if (right < last_inner) narrowing++;
+        last_inner = right;
+    }
+    CHECK(stopped == 0);
+    CHECK(narrowing == 0);
+    CHECK(left > right);
+    CHECK(r.failures == failures + 1);
+}
+
+// ==================== Distance filter ====================
+
+static void check_distance_filter(void) {
+    StateEstimator e;
+    estimator_init(&e);
+    DistanceFilter* f = &e.distance;
+
+    // Settle on a box at rest 0.5 m away
+    for (int i = 0; i < 20; i++) {
+        distance_filter_predict(f, 0.0f, 0.05f);
+        CHECK(distance_filter_update(f, 0.5f) == 1);
+    }
+    CHECK(fabsf(f->d - 0.5f) < 0.01f);
+
+    // One glitch is gated and leaves the estimate alone; the next good reading clears the count
+    distance_filter_predict(f, 0.0f, 0.05f);
+    CHECK(distance_filter_update(f, 0.1f) == 0);
+    CHECK(fabsf(f->d - 0.5f) < 0.01f);
+    CHECK(f->rejects == 1 && f->consecutive_rejects == 1);
+    distance_filter_predict(f, 0.0f, 0.05f);
+    CHECK(distance_filter_update(f, 0.5f) == 1);
+    CHECK(f->consecutive_rejects == 0);
+
+    // The scene changed: ESTIMATOR_MAX_REJECTS disagreeing readings in a row restart the filter
+    for (int i = 1; i < ESTIMATOR_MAX_REJECTS; i++) {
+        distance_filter_predict(f, 0.0f, 0.05f);
+        CHECK(distance_filter_update(f, 0.1f) == 0);
+        CHECK(fabsf(f->d - 0.5f) < 0.01f);
+    }
+    distance_filter_predict(f, 0.0f, 0.05f);
+    CHECK(distance_filter_update(f, 0.1f) == 1);
+    CHECK(fabsf(f->d - 0.1f) < EPS);
+    CHECK(fabsf(f->p00 - f->r) < EPS && f->b == 0.0f);
+    CHECK(f->consecutive_rejects == 0);
+    CHECK(f->rejects == 1 + ESTIMATOR_MAX_REJECTS);
+}
+
+// ==================== Recording index ====================
+
+#define CHECK_RECORDING "check_behaviour_recording.in"
+
+/**
+ * @brief Reads on from the current position to the next sensor line
+ * @return Number of the line ("line N"), or -1 at the end of the recording
+ */
+static int next_line_number(RecordingReader* rd, double* timestamp) {
+    RecordingRecord rec;
+    while (recording_next(rd, &rec)) {
+        if (rec.type != REC_SENSOR_LINE) continue;
+        char text[32];
+        int n = rec.length < sizeof(text) - 1 ? rec.length : (int)sizeof(text) - 1;
+        memcpy(text, rec.payload, (size_t)n);
+        text[n] = '\0';
+        *timestamp = rec.timestamp;
+        return atoi(text + 5);
+    }
+    return -1;
+}
+
+static void check_recording_index(void) {
+    // 100 s of sensor lines at 10 Hz; state 2 is entered every 20 s, state 1 in between
+    Recorder w;
+    CHECK(recorder_open(&w, CHECK_RECORDING) == 1);
+    for (int i = 0; i < 1000; i++) {
+        double t = 100.0 + 0.1 * i;
+        if (i % 200 == 100) recorder_mark_state(&w, t, 2);
+        else if (i % 200 == 0) recorder_mark_state(&w, t, 1);
+        char line[32];
+        int n = snprintf(line, sizeof(line), "line %d", i);
+        recorder_append(&w, REC_SENSOR_LINE, t, line, (size_t)n);
+    }
+    CHECK(w.write_errors == 0);
+    recorder_close(&w);
+
+    RecordingReader rd;
+    CHECK(recording_reader_open(&rd, CHECK_RECORDING) == 1);
+    double t = 0;
+
+    // Third entry into state 2: the mark, then the line recorded right after it
+    RecordingRecord rec;
+    const RecordingIndexEntry* e = recording_find_state(&rd, 2, 3);
+    CHECK(e != NULL);
+    if (e) {
+        CHECK(e->state_ordinal == 3 && fabs(e->timestamp - 150.0) < 1e-9);
+        CHECK(recording_seek(&rd, e) == 1);
+        int read = recording_next(&rd, &rec);
+        CHECK(read == 1);
+        if (read) CHECK(rec.type == REC_STATE && rec.length == sizeof(int32_t) && *(const int32_t*)rec.payload == 2);
+        CHECK(next_line_number(&rd, &t) == 500);
+        CHECK(next_line_number(&rd, &t) == 501);
+    }
+    CHECK(recording_find_state(&rd, 2, 6) == NULL);
+
+    // 42.35 s in: the index points at or before that time, reading on reaches the line
+    e = recording_find_time(&rd, 142.35);
+    CHECK(e != NULL && e->timestamp <= 142.35 && e->timestamp > 141.0);
+    CHECK(recording_seek(&rd, e) == 1);
+    int line = next_line_number(&rd, &t);
+    while (line >= 0 && t < 142.35) line = next_line_number(&rd, &t);
+    CHECK(line == 424);
+    CHECK(recording_find_time(&rd, 99.0) == NULL);
+
+    // Back to the start and through to the end: every line once, in order
+    CHECK(recording_rewind(&rd) == 1);
+    int count = 0, in_order = 1;
+    while ((line = next_line_number(&rd, &t)) >= 0) {
+        if (line != count) in_order = 0;
+        count++;
+    }
+    CHECK(count == 1000 && in_order);
+    recording_reader_close(&rd);
+
+    remove(CHECK_RECORDING ".idx");
+    remove(CHECK_RECORDING ".seg000000");
+}
+
+int main(void) {
+    check_wheel_shaper();
+    check_line_recovery();
+    check_distance_filter();
+    check_recording_index();
+    if (failures) {
+        printf("%d behaviour checks failed\n", failures);
+        return 1;
+    }
+    printf("All behaviour checks passed\n");
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/*
+ * Minimal Google-Benchmark-style harness for C.
+ *
+ * A benchmark is a function that runs its body `iterations` times. The
+ * harness grows the iteration count until one run takes at least
+ * MICROBENCH_MIN_TIME seconds and reports the time per iteration.
+ *
+ * Command line:
+ *   --benchmark_filter=<substring>   run only matching benchmarks
+ *   --benchmark_format=json          machine-readable output
+ *   --benchmark_min_time=<seconds>   minimum measured time per benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../clock_util.h"
+
+#define MICROBENCH_MIN_TIME 0.2
+
+typedef void (*MicrobenchFn)(long iterations);
+
+typedef struct {
+    const char* name;
+    MicrobenchFn fn;
+} Microbench;
+
+// Keeps the compiler from optimising a computed value away
+#if defined(__GNUC__) || defined(__clang__)
+    #define DO_NOT_OPTIMIZE(value) __asm__ __volatile__("" : : "g"(value) : "memory")
+    #define CLOBBER_MEMORY() __asm__ __volatile__("" : : : "memory")
+#else
+    #define DO_NOT_OPTIMIZE(value) do { volatile void* sink_ = (void*)&(value); (void)sink_; } while (0)
+    #define CLOBBER_MEMORY() do { } while (0)
+#endif
+
+/**
+ * @brief Runs the given benchmarks and prints one line (or JSON object) per benchmark
+ * @return 0
+ */
+static inline int microbench_main(int argc, char** argv, const Microbench* benches, int count) {
+    const char* filter = NULL;
+    int json = 0;
+    double min_time = MICROBENCH_MIN_TIME;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--benchmark_filter=", 19) == 0) filter = argv[i] + 19;
+        else if (strcmp(argv[i], "--benchmark_format=json") == 0) json = 1;
+        else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0) min_time = atof(argv[i] + 21);
+    }
+
+    if (json) printf("{\n  \"benchmarks\": [\n");
+    else printf("%-32s %14s %14s\n", "Benchmark", "Time", "Iterations");
+
+    int printed = 0;
+    for (int b = 0; b < count; b++) {
+        if (filter && !strstr(benches[b].name, filter)) continue;
+
+        long iterations = 1;
+        double elapsed = 0;
+        for (;;) {
+            double start = monotonic_seconds();
+            benches[b].fn(iterations);
+            elapsed = monotonic_seconds() - start;
+            if (elapsed >= min_time || iterations >= (1L << 40)) break;
+
+            // Aim for the target time directly once there is a usable measurement
+            double factor = elapsed > 1e-6 ? 1.4 * min_time / elapsed : 10.0;
+            if (factor > 10.0) factor = 10.0;
+            if (factor < 2.0) factor = 2.0;
+            iterations = (long)(iterations * factor);
+        }
+
+        double ns = elapsed * 1e9 / (double)iterations;
+        if (json) {
+            printf("%s    {\"name\": \"%s\", \"iterations\": %ld, \"real_time\": %.3f, \"time_unit\": \"ns\"}",
+                   printed ? ",\n" : "", benches[b].name, iterations, ns);
+        } else {
+            printf("%-32s %11.2f ns %14ld\n", benches[b].name, ns, iterations);
+        }
+        printed++;
+    }
+
+    if (json) printf("\n  ]\n}\n");
+    return 0;
+}
+
+#endif // MICROBENCH_H
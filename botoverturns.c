@@ -6,349 +6,376 @@
 *  Task 2a: Pick and Place using PID line following
 */
 
-#ifdef _WIN32
-    #define WINVER 0x0600
-    #define _WIN32_WINNT 0x0600
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-    #include <windows.h>
-    typedef SOCKET SocketType;
-    #define CLOSESOCKET closesocket
-    #define READ(s, buf, len) recv(s, buf, len, 0)
-    #define SLEEP(ms) Sleep(ms)
-    #pragma comment(lib, "Ws2_32.lib")
-#else
-    #include <unistd.h>
-    #include <arpa/inet.h>
-    #include <sys/socket.h>
-    #include <pthread.h>
-    typedef int SocketType;
-    #define CLOSESOCKET close
-    #define READ(s, buf, len) read(s, buf, len)
-    #define SLEEP(ms) usleep((ms)*1000)
-#endif
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
+#include "coppeliasim_client.h"
 #include <math.h>
-
-// ==================== SocketClient ====================
-typedef struct {
-    SocketType sock;
-    bool running;
-
-    float line_sensors[5];   // left_corner, left, middle, right, right_corner
-    float proximity_distance;
-    float color_r, color_g, color_b;
-
-#ifdef _WIN32
-    HANDLE recv_thread;
-#else
-    pthread_t recv_thread;
+#include "telemetry.h"
+#include "clock_util.h"
+#include "sensor_kernels.h"
+#include "lifecycle.h"
+#include "rt_thread.h"
+#include "state_estimator.h"
+#include "motion_profile.h"
+#include "line_recovery.h"
+#include "wheel_shaping.h"
+#include "fault_injection.h"
+#include "metrics.h"
+
+// Per-tick log line on stdout; telemetry is always recorded
+#ifndef TICK_LOG
+#define TICK_LOG 1
 #endif
-} SocketClient;
 
-SocketClient client;
-
-// ----------- Function Declarations -----------
-bool connect_to_server(SocketClient* c, const char* ip, int port);
-void disconnect(SocketClient* c);
-void* receive_loop(void* arg);
-void set_motor(SocketClient* c, float left, float right);
-int pick_box(SocketClient* c);
-int drop_box(SocketClient* c);
-
-// ==================== Implementations ====================
+SocketClient* client;
+
+#define TELEMETRY_FILE "botoverturns_telemetry.cbt"
+TelemetryStore telemetry;
+Watchdog watchdog;
+RtThreadConfig control_rt, receive_rt;  // CB_RT_CONTROL_* / CB_RT_RECEIVE_*
+bool action_acks;                       // CB_ACTION_ACKS: the server acknowledges PICK/DROP
+ControlMetrics metrics;                 // Served on CB_METRICS_SOCKET when set (see metrics.h)
+MetricsServer metrics_server;
+
+// ==================== Controller ====================
+// Controller state lives here between ticks, so control_loop and the headless
+// benchmarks can both drive it one step at a time
+#define BOT_PERIOD_MS 5
+
+static enum {SEARCHING, NAVIGATING, DROPPING, APPROACHING, PICKING} state=SEARCHING;
+static const char* const state_names[] = {"SEARCHING", "NAVIGATING", "DROPPING", "APPROACHING", "PICKING"};
+static PidState pid;
+static int drop_zone=0;
+
+// Filtered box distance and the speed profile that brings the robot to rest in front of it
+static StateEstimator est;
+static ApproachProfile approach;
+static double last_tick=-1, pick_started=0, node_clear_until=0;
+static int clear_frames=0;
+static ActionId arm_action=0;  // PICK / DROP in progress
+LineRecovery recovery;         // Search for a lost line, guided by where it was last seen
+WheelShaper shaper;            // Keeps the PID steering when the base speed saturates the wheels
+
+static float picked_r=0, picked_g=0, picked_b=0;
+
+static const PidGains gains={1.2f, 0.0f, 0.5f};
+static const float base_speed=2.6;
+static const float proximity_threshold=1.0;  // box detection
+static const float pick_distance=0.15;       // m, pick pose in front of the box
+static const int pickup_clear_frames=3;      // frames without the box that confirm a pick
+static const int approach_lost_frames=10;    // frames without the box that abort an approach
+static const float color_tolerance=0.1;      // for dropping
+static const float recovery_speed=0.6;       // forward wheel command while arcing towards a lost line
+static const float recovery_turn=0.4;        // wheel command while pivoting
+static const float wheel_slew=8.0;           // wheel command units per second
+static const double node_clear_time=0.1;     // s, node detection is off while driving over the node
+
+/**
+ * @brief Resets the state machine and its filters; call before the first botoverturns_step
+ */
+void botoverturns_init(void){
+    state=SEARCHING;
+    memset(&pid,0,sizeof(pid));
+    drop_zone=0;
+    last_tick=-1; pick_started=0; node_clear_until=0;
+    clear_frames=0;
+    arm_action=0;
+    picked_r=picked_g=picked_b=0;
+    estimator_init(&est);
+    approach_profile_init(&approach, 1.0f, pick_distance, est.speed_gain);
+    line_recovery_init(&recovery);
+    wheel_shaper_init(&shaper, 0.0f, 1.0f, wheel_slew);
+    metrics_init(&metrics, state_names, (int)(sizeof(state_names)/sizeof(state_names[0])));
+}
 
-// Connect to CoppeliaSim
-bool connect_to_server(SocketClient* c, const char* ip, int port) {
-#ifdef _WIN32
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2,2), &wsa) != 0) return false;
-#endif
+/**
+ * @brief Current state of the state machine (benchmarks)
+ */
+int botoverturns_state(void){
+    return state;
+}
 
-    c->sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (c->sock < 0) return false;
+/**
+ * @brief Runs one tick of the controller on the current sensor values
+ * @param c Pointer to SocketClient structure
+ * @param now Monotonic time in seconds
+ * @return Milliseconds to wait before the next tick
+ */
+int botoverturns_step(SocketClient* c, double now){
+    // Hold still while disconnected; PID and state machine resume afterwards
+    if(!client_ready(c)) return BOT_PERIOD_MS;
+    // Stale sensor data: stop instead of steering on old values
+    if(check_watchdog(c)==0.0f){ set_motor(c,0,0); return BOT_PERIOD_MS; }
+
+    const ClientSnapshot* s = client_snapshot(c);
+    float ir[5]; for(int i=0;i<5;i++) ir[i]=s->line_sensors[i];
+    float prox = s->proximity_distance;
+    float r = s->color_r, g=s->color_g, b=s->color_b;
+    bool box_seen = prox < proximity_threshold && (r>0.1 || g>0.1 || b>0.1);
+
+    // Estimator: predict over the tick time, correct once per new frame
+    float dt = last_tick >= 0 ? (float)(now - last_tick) : 0.0f;
+    last_tick = now;
+    estimator_predict(&est, s->motor_left, s->motor_right, dt);
+    unsigned long frames = client_stats(c)->frames_received;
+    bool new_frame = frames != est.last_frame;
+    bool line_seen = false;
+    for(int i=0;i<5;i++) if(ir[i]<LINE_SEEN_THRESHOLD) line_seen = true;
+    if(new_frame){
+        estimator_correct(&est, prox, classify_line(ir) != LINE_LOST, line_centroid_error(ir));
+        est.last_frame = frames;
+        line_recovery_observe(&recovery, line_seen, line_centroid_error(ir), now);
+    }
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = inet_addr(ip);
+    // PID
+    float error = line_centroid_error(ir);
+    float derivative = error - pid.prev_error;
+    float corr = pid_step(&pid,&gains,error);
+
+    // Adjust speed if carrying box
+    float current_base_speed = base_speed;
+    if(state == NAVIGATING || state == DROPPING) current_base_speed += 1.6;
+
+    // Wheels limited to [0,1]: lower the common mode rather than clipping each wheel,
+    // so the correction survives a saturating base speed
+    float left=current_base_speed + corr;
+    float right=current_base_speed - corr;
+    wheel_shaper_apply(&shaper, &left, &right, s->motor_left, s->motor_right, dt);
+
+    // No sensor on the line: the centroid reads 0 and PID would drive straight on,
+    // so search towards where the line was last seen instead
+    if(!line_seen && (state == SEARCHING || state == NAVIGATING)){
+        unsigned long failures = recovery.failures;
+        line_recovery_steer(&recovery, now, recovery_speed, recovery_turn, &left, &right);
+        if(recovery.failures != failures) printf("Line lost for %.1f s, spiralling outwards\n", recovery.timeout_s);
+    }
 
-    if (connect(c->sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    // --- State Machine ---
+    switch(state){
+        case SEARCHING:
+            set_motor(c,left,right);
+            // Object detected (proximity + color): decelerate into the pick pose
+            if(box_seen){
+                approach_profile_start(&approach, 0.5f*(s->motor_left+s->motor_right));
+                clear_frames = 0;
+                state=APPROACHING;
+            }
+            break;
 
-    c->running = true;
+        case APPROACHING: {
+            if(new_frame) clear_frames = box_seen ? 0 : clear_frames+1;
+            float closing = estimator_closing_speed(&est, s->motor_left, s->motor_right);
+            if(approach_profile_settled(&approach, est.distance.d, closing)){
+                // At rest in front of the box: pick instead of waiting a fixed settle time
+                set_motor(c,0,0);
+                arm_action = client_pick(c,NULL,NULL);
+                if(!arm_action) break;  // Not sent; try again next tick
+
+                // Record picked color
+                picked_r = r; picked_g = g; picked_b = b;
+
+                // Determine drop zone
+                if(r>g && r>b) drop_zone=1;      // RED -> Zone 1
+                else if(b>r && b>g) drop_zone=2; // BLUE -> Zone 2
+                else drop_zone=3;                // GREEN -> Zone 3
+
+                printf("Picked box! RGB:(%.2f,%.2f,%.2f) -> Zone %d\n",r,g,b,drop_zone);
+                pick_started = now;
+                clear_frames = 0;
+                state=PICKING;
+            } else if(clear_frames >= approach_lost_frames){
+                printf("Box lost during approach\n");
+                state=SEARCHING;
+            } else {
+                // Profile speed, steering scaled down with it so the robot stops straight
+                float v = approach_profile_step(&approach, est.distance.d, closing, dt);
+                left = v + corr*v;
+                right = v - corr*v;
+                if(left<0) left=0;
+                if(right<0) right=0;
+                set_motor(c,left,right);
+            }
+            break;
+        }
 
-#ifdef _WIN32
-    c->recv_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)receive_loop, c, 0, NULL);
-#else
-    pthread_create(&c->recv_thread, NULL, receive_loop, c);
-#endif
+        case PICKING: {
+            // Hold still until the pick completes. Without acknowledgements the box
+            // leaving the sensors for a few frames is better evidence than the assumed time.
+            // An acknowledged pick also waits for those frames: until the box is gone, the
+            // color sensor still sees it and would match the drop zone on the spot.
+            set_motor(c,0,0);
+            if(new_frame) clear_frames = box_seen ? 0 : clear_frames+1;
+            bool box_gone = clear_frames >= pickup_clear_frames;
+            ActionStatus pick = client_action_status(c, arm_action);
+            if(pick == ACTION_PENDING && !action_acks && box_gone) pick = ACTION_DONE;
+            if(pick == ACTION_DONE && !box_gone) break;
+            if(pick == ACTION_DONE){
+                printf("Pick complete after %.0f ms\n", (now - pick_started)*1000.0);
+                arm_action = 0;
+                state=NAVIGATING;
+            } else if(pick != ACTION_PENDING){
+                printf("Pick failed, searching again\n");
+                arm_action = 0;
+                state=SEARCHING;
+            }
+            break;
+        }
 
-    return true;
-}
+        case NAVIGATING: {
+            // Node Detection: Using ir[1..3] to detect junction
+            bool at_node = (ir[1]<0.4 && ir[2]<0.4 && ir[3]<0.4);
 
-void disconnect(SocketClient* c) {
-    c->running = false;
-#ifdef _WIN32
-    WaitForSingleObject(c->recv_thread, INFINITE);
-#else
-    pthread_join(c->recv_thread, NULL);
-#endif
+            if(at_node && now >= node_clear_until){
+                // Handle the node once, not on every tick spent driving over it
+                node_clear_until = now + node_clear_time;
 
-    if(c->sock != -1) CLOSESOCKET(c->sock);
-#ifdef _WIN32
-    WSACleanup();
-#endif
-}
+                // No turn is forced here: PID line following carries on until the color
+                // sensor matches the box, which marks the drop zone
+                static const char* const zone_colors[] = {"?", "RED", "BLUE", "GREEN"};
+                printf("Node reached carrying a %s box (zone %d)\n", zone_colors[drop_zone], drop_zone);
+            }
 
-// Send motor commands
-void set_motor(SocketClient* c, float left, float right) {
-    if(c->sock == -1) return;
-    char cmd[128];
-    snprintf(cmd,sizeof(cmd),"L:%.2f;R:%.2f\n", left, right);
-    send(c->sock, cmd, strlen(cmd), 0);
-}
+            // Resume normal PID line following
+            set_motor(c, left, right);
 
-// Pick / Drop
-int pick_box(SocketClient* c){
-    if(!c->running || c->sock == -1) return 0;
-    return send(c->sock,"PICK\n",5,0) > 0;
-}
-int drop_box(SocketClient* c){
-    if(!c->running || c->sock == -1) return 0;
-    return send(c->sock,"DROP\n",5,0) > 0;
-}
+            // Check if destination reached (motion sensor picks color picked)
+            bool color_match = fabs(r-picked_r)<color_tolerance &&
+                               fabs(g-picked_g)<color_tolerance &&
+                               fabs(b-picked_b)<color_tolerance;
 
-// Receive sensor updates
-void* receive_loop(void* arg){
-    SocketClient* c = (SocketClient*)arg;
-    char buffer[2048];
-    char line[2048];
-    int pos = 0;
-
-    while(c->running){
-        int n = READ(c->sock, buffer, sizeof(buffer)-1);
-        if(n>0){
-            buffer[n]='\0';
-            for(int i=0;i<n;i++){
-                if(buffer[i]=='\n'){
-                    line[pos]='\0';
-                    pos=0;
-
-                    // Parse line: S:..;P:..;C:..
-                    char line_copy[2048]; strcpy(line_copy,line);
-                    char* seg=line_copy;
-                    char* next=NULL;
-                    do {
-                        next = strchr(seg,';');
-                        if(next){ *next='\0'; next++; }
-
-                        if(strncmp(seg,"S:",2)==0){
-                            float* arr = c->line_sensors;
-                            int idx=0;
-                            char* tok = strtok(seg+2,",");
-                            while(tok && idx<5){ arr[idx++]=atof(tok); tok=strtok(NULL,","); }
-                        } else if(strncmp(seg,"P:",2)==0){
-                            c->proximity_distance = atof(seg+2);
-                        } else if(strncmp(seg,"C:",2)==0){
-                            char* tok = strtok(seg+2,",");
-                            c->color_r = atof(tok);
-                            tok = strtok(NULL,",");
-                            c->color_g = atof(tok);
-                            tok = strtok(NULL,",");
-                            c->color_b = atof(tok);
-                        }
-
-                        seg = next;
-                    } while(seg);
-                } else {
-                    if(pos<2047) line[pos++]=buffer[i];
-                }
+            if(color_match){
+                printf("Destination reached! Color match detected\n");
+                state=DROPPING;
             }
+            break;
         }
-        SLEEP(1);
-    }
-    return NULL;
-}
 
-// ==================== Control Loop ====================
-void* control_loop(void* arg){
-    SocketClient* c = (SocketClient*)arg;
-
-    float prev_error=0, integral=0;
-    enum {SEARCHING, NAVIGATING, DROPPING} state=SEARCHING;
-    int drop_zone=0;
-
-    float picked_r=0, picked_g=0, picked_b=0;
-
-    const float Kp=1.2, Ki=0.0, Kd=0.5;
-    const float base_speed=2.6;
-    const float proximity_threshold=1.0;  // box detection
-    const int pickup_delay=500;  // ms
-    const float color_tolerance=0.1;      // for dropping
-
-    while(c->running){
-        float ir[5]; for(int i=0;i<5;i++) ir[i]=c->line_sensors[i];
-        float prox = c->proximity_distance;
-        float r = c->color_r, g=c->color_g, b=c->color_b;
-
-        // PID
-        float w[5]={-2,-1,0,1,2}, ws=0, sum=0;
-        for(int i=0;i<5;i++){ float v=1-ir[i]; ws+=w[i]*v; sum+=v;}
-        float error = sum>0?ws/sum:0;
-        integral+=error;
-        float derivative = error-prev_error;
-        float corr = Kp*error + Ki*integral + Kd*derivative;
-        prev_error=error;
-
-        // Adjust speed if carrying box
-        float current_base_speed = base_speed;
-        if(state == NAVIGATING || state == DROPPING) current_base_speed += 1.6;
-
-        float left=current_base_speed + corr;
-        float right=current_base_speed - corr;
-        if(left>1) left=1; if(left<0) left=0;
-        if(right>1) right=1; if(right<0) right=0;
-
-        // --- State Machine ---
-        switch(state){
-            case SEARCHING:
-                set_motor(c,left,right);
-                // Pick if object detected (proximity + color)
-                if(prox < proximity_threshold && (r>0.1 || g>0.1 || b>0.1)){
-                    set_motor(c,0,0);
-                    SLEEP(500);
-                    pick_box(c);
-                    SLEEP(pickup_delay);
-
-                    // Record picked color
-                    picked_r = r; picked_g = g; picked_b = b;
-
-                    // Determine drop zone
-                    if(r>g && r>b) drop_zone=1;      // RED -> Zone 1
-                    else if(b>r && b>g) drop_zone=2; // BLUE -> Zone 2
-                    else drop_zone=3;                // GREEN -> Zone 3
-
-                    printf("Picked box! RGB:(%.2f,%.2f,%.2f) -> Zone %d\n",r,g,b,drop_zone);
-                    state=NAVIGATING;
-                }
-                break;
-
-            case NAVIGATING: {
-                // Node Detection: Using ir[1..3] to detect junction
-                bool at_node = (ir[1]<0.4 && ir[2]<0.4 && ir[3]<0.4);
-
-                if(at_node){
-                    // --- LEFT TURN (GREEN box / drop_zone==3) ---
-                    if(drop_zone==3){
-                        printf("GREEN box detected - Turning LEFT\n");
-                        while(c->running){
-                            float left_speed=0.1, right_speed=0.6; // start left turn
-
-                            // Adjust speeds based on corner -> side -> middle sensors
-                            if(c->line_sensors[0]<0.5) left_speed=0.3;  // left corner sees black
-                            if(c->line_sensors[1]<0.5) left_speed=0.4;  // left side sees black
-                            if(c->line_sensors[2]<0.5) left_speed=0.5;  // middle sees black, done
-
-                            set_motor(c, left_speed, right_speed);
-
-                            // Update IR sensors
-                            for(int i=0;i<5;i++) ir[i]=c->line_sensors[i];
-
-                            // Exit turn when middle sees black
-                            if(c->line_sensors[2]<0.5) break;
-                            SLEEP(5);
-                        }
-                    }
-
-                    // --- RIGHT TURN (RED box / drop_zone==1) ---
-                    else if(drop_zone==1){
-                        printf("RED box detected - Turning RIGHT\n");
-                        while(c->running){
-                            float left_speed=0.6, right_speed=0.1; // start right turn
-
-                            // Adjust speeds based on corner -> side -> middle sensors
-                            if(c->line_sensors[4]<0.5) right_speed=0.3;  // right corner sees black
-                            if(c->line_sensors[3]<0.5) right_speed=0.4;  // right side sees black
-                            if(c->line_sensors[2]<0.5) right_speed=0.5;  // middle sees black, done
-
-                            set_motor(c, left_speed, right_speed);
-
-                            // Update IR sensors
-                            for(int i=0;i<5;i++) ir[i]=c->line_sensors[i];
-
-                            // Exit turn when middle sees black
-                            if(c->line_sensors[2]<0.5) break;
-                            SLEEP(5);
-                        }
-                    }
-
-                    // --- BLUE box: GO STRAIGHT ---
-                    else if(drop_zone==2){
-                        printf("BLUE box detected - Going STRAIGHT\n");
-                        // Small delay at node to clear it
-                        SLEEP(100);
-                    }
-                }
-
-                // Resume normal PID line following
-                set_motor(c, left, right);
-
-                // Check if destination reached (motion sensor picks color picked)
-                bool color_match = fabs(r-picked_r)<color_tolerance &&
-                                   fabs(g-picked_g)<color_tolerance &&
-                                   fabs(b-picked_b)<color_tolerance;
-
-                if(color_match){
-                    printf("Destination reached! Color match detected\n");
-                    state=DROPPING;
-                }
+        case DROPPING: {
+            // Stop robot and drop box; the loop keeps running while the arm works
+            set_motor(c,0,0);
+            if(!arm_action){
+                arm_action = client_drop(c,NULL,NULL);
                 break;
             }
-
-            case DROPPING: {
-                // Stop robot and drop box
-                set_motor(c,0,0);
-                drop_box(c);
-                SLEEP(1000);
-                
+            ActionStatus drop = client_action_status(c, arm_action);
+            if(drop == ACTION_PENDING) break;
+            arm_action = 0;  // Failed drops are sent again on the next tick
+            if(drop == ACTION_DONE){
                 printf("Dropped box at zone %d\n",drop_zone);
                 state=SEARCHING;
-                break;
             }
+            break;
         }
+    }
 
-        printf("State:%d | L:%.2f R:%.2f | Prox:%.2f | RGB:(%.2f,%.2f,%.2f)\n",
-               state,left,right,prox,r,g,b);
+    TelemetrySample sample;
+    memset(&sample,0,sizeof(sample));
+    sample.timestamp = now;
+    sample.state = state;
+    for(int i=0;i<5;i++) sample.ir[i]=ir[i];
+    sample.proximity = prox;
+    sample.color_r = r; sample.color_g = g; sample.color_b = b;
+    sample.pid_error = error;
+    sample.pid_p = gains.Kp*error; sample.pid_i = gains.Ki*pid.integral; sample.pid_d = gains.Kd*derivative;
+    sample.left = left; sample.right = right;
+    telemetry_record(&telemetry,&sample);
+    metrics_record_tick(&metrics, now, state, line_seen, error);
+
+#if TICK_LOG
+    printf("State:%d | L:%.2f R:%.2f | Prox:%.2f | RGB:(%.2f,%.2f,%.2f)\n",
+           state,left,right,prox,r,g,b);
+#endif
 
-        SLEEP(5);
+    return BOT_PERIOD_MS;
+}
+
+// ==================== Control Loop ====================
+void* control_loop(void* arg){
+    SocketClient* c = (SocketClient*)arg;
+    rt_thread_apply(&control_rt, "control");
+
+    while(client_running(c) && !lifecycle_stop_requested()){
+        SLEEP(botoverturns_step(c, monotonic_seconds()));
     }
 
+    line_recovery_report(&recovery, "Line recovery");
+    wheel_shaper_report(&shaper, "Wheel shaping");
     return NULL;
 }
 
+#ifndef BOTOVERTURNS_NO_MAIN
 // ==================== Main ====================
 int main(){
     printf("Initializing Task2a...\n");
-    if(!connect_to_server(&client,"127.0.0.1",50002)){
+    if(!lifecycle_init()) printf("Failed to install signal handlers\n");
+    watchdog_init_from_env(&watchdog);
+    ClientConfig config;
+    client_config_init(&config);
+    config.watchdog = &watchdog;
+    const char* acks = getenv("CB_ACTION_ACKS");
+    action_acks = acks && atoi(acks)!=0;
+    config.action_acks = action_acks;
+    const char* refresh = getenv("CB_MOTOR_REFRESH_MS");
+    if(refresh) config.motor_refresh_ms = atoi(refresh);
+    rt_thread_config_from_env(&control_rt, "CONTROL");
+    rt_thread_config_from_env(&receive_rt, "RECEIVE");
+    config.receive_rt = &receive_rt;
+    rt_lock_memory_from_env();
+
+    FaultConfig faults;
+    FaultLink* fault_link = NULL;
+    if(fault_config_from_env(&faults) && (fault_link = fault_link_create(config.transport, &faults)) != NULL){
+        config.transport = &fault_transport;
+        config.transport_state = fault_link;
+        fault_config_print(&faults, "Fault injection");
+    }
+
+    client = client_create(&config);
+    if(!client || !client_connect(client)){
         printf("Failed to connect!\n");
+        client_destroy(client);
+        fault_link_destroy(fault_link);
         return -1;
     }
     printf("Connected to CoppeliaSim!\n");
 
+    if(!telemetry_init(&telemetry, TELEMETRY_DEFAULT_CAPACITY))
+        printf("Telemetry allocation failed, continuing without recording\n");
+    botoverturns_init();
+
+    // CB_METRICS_SOCKET: serve live counters (state times, PID error RMS, link) on a Unix socket
+    const char* metrics_path = getenv("CB_METRICS_SOCKET");
+    if(metrics_path && *metrics_path && metrics_server_start(&metrics_server, metrics_path, &metrics, client))
+        printf("Metrics on %s\n", metrics_path);
+
 #ifdef _WIN32
-    HANDLE t = CreateThread(NULL,0,(LPTHREAD_START_ROUTINE)control_loop,&client,0,NULL);
+    HANDLE t = CreateThread(NULL,0,(LPTHREAD_START_ROUTINE)control_loop,client,0,NULL);
 #else
     pthread_t t;
-    pthread_create(&t,NULL,control_loop,&client);
+    pthread_create(&t,NULL,control_loop,client);
 #endif
 
     printf("Monitoring sensors... Ctrl+C to exit\n");
-    while(1) SLEEP(100);
+    while(client_running(client) && !lifecycle_wait(100)) {}
+    bool connection_lost = !client_running(client);
+    lifecycle_request_stop();
 
-    disconnect(&client);
-    return 0;
+    // Stop the controller, then the robot, then the connection
+#ifdef _WIN32
+    WaitForSingleObject(t,INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t,NULL);
+#endif
+    set_motor(client,0,0);
+    metrics_server_stop(&metrics_server);
+    client_destroy(client);
+    if(fault_link) fault_injector_report(&fault_link->injector, "Fault injection");
+    fault_link_destroy(fault_link);
+    printf("Watchdog: %u stop events, %u slowdowns, max frame age %.0f ms\n",
+           watchdog.stop_events, watchdog.degrade_events, watchdog.max_age*1000.0);
+
+    if(telemetry.count>0 && telemetry_export(&telemetry, TELEMETRY_FILE))
+        printf("Telemetry written to %s (%zu ticks)\n", TELEMETRY_FILE, telemetry.count);
+    telemetry_destroy(&telemetry);
+    return connection_lost ? 1 : 0;
 }
+#endif // BOTOVERTURNS_NO_MAIN
@@ -0,0 +1,26 @@
+#ifndef CLOCK_UTIL_H
+#define CLOCK_UTIL_H
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+/**
+ * @brief Monotonic time in seconds, unaffected by wall-clock adjustments
+ */
+static inline double monotonic_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+#endif // CLOCK_UTIL_H
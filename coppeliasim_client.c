@@ -0,0 +1,998 @@
+/*
+ * Single translation unit of the CoppeliaSim socket client.
+ * Built into the coppeliasim_client library; controllers only include the header.
+ */
+#ifdef _WIN32
+    #define WINVER 0x0600
+    #define _WIN32_WINNT 0x0600
+#endif
+
+#include "coppeliasim_client.h"
+#include <math.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include "memory_pool.h"
+
+#ifdef _WIN32
+    #include <ws2tcpip.h>
+    typedef SOCKET SocketType;
+    #define CLOSESOCKET closesocket
+    #define READ(s, buf, len) recv(s, buf, len, 0)
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <arpa/inet.h>
+    #include <sys/socket.h>
+    typedef int SocketType;
+    #define CLOSESOCKET close
+    #define READ(s, buf, len) read(s, buf, len)
+#endif
+
+// Mutex serializing writes with closing and reopening the link
+#ifdef _WIN32
+    typedef CRITICAL_SECTION ClientMutex;
+    #define MUTEX_INIT(m) InitializeCriticalSection(m)
+    #define MUTEX_LOCK(m) EnterCriticalSection(m)
+    #define MUTEX_UNLOCK(m) LeaveCriticalSection(m)
+    #define MUTEX_DESTROY(m) DeleteCriticalSection(m)
+#else
+    typedef pthread_mutex_t ClientMutex;
+    #define MUTEX_INIT(m) pthread_mutex_init(m, NULL)
+    #define MUTEX_LOCK(m) pthread_mutex_lock(m)
+    #define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+    #define MUTEX_DESTROY(m) pthread_mutex_destroy(m)
+#endif
+
+// Receive path buffer sizes (allocated once from the client arena)
+#define RX_BUFFER_SIZE 2048
+#define LINE_BUFFER_SIZE 2048
+
+// Outgoing commands and parsed frames live on the stack
+#define COMMAND_MAX_LENGTH 64
+
+// State marks queued for the input recording; a power of two
+#define STATE_MARK_SLOTS 16
+
+// Arm actions in flight; action id N lives in slot N % ACTION_SLOTS
+#define ACTION_SLOTS 8
+
+// The control thread fills a free slot and publishes it as ACTION_PENDING before
+// sending, so a fast answer always finds it. Whichever thread moves the slot out
+// of ACTION_PENDING (compare-and-swap) finishes the action.
+typedef struct {
+    _Atomic(ActionId) id;
+    _Atomic(ActionStatus) status;
+    double sent_time;
+    double deadline;                    // Timeout, or assumed completion without acknowledgements
+    ActionStatus at_deadline;           // ACTION_TIMED_OUT or ACTION_DONE
+    ActionCallback callback;
+    void* user;
+} ActionSlot;
+
+struct SocketClient {
+    ClientSnapshot snapshot;            // Must stay first, see client_snapshot()
+
+    const ClientTransport* transport;
+    ClientConnection conn;
+    bool running;
+
+    // Preallocated memory so the steady-state path never calls malloc
+    Arena rx_arena;                     // Receive and line buffers
+    char* rx_buffer;                    // Transport read buffer (from rx_arena)
+    char* line_buffer;                  // Partial line being assembled (from rx_arena)
+    int line_pos;
+
+    // Stale-data failsafe (NULL when disabled), checked from the control thread
+    Watchdog* watchdog;
+    double last_frame_time;             // When the newest sensor line was applied
+    float speed_scale;                  // Last watchdog answer, applied by set_motor
+    int motor_refresh_ms;               // 0 = send every wheel command
+
+    // Last wheel command sent, so unchanged ones can be coalesced (control thread)
+    char last_motor[COMMAND_MAX_LENGTH];
+    int last_motor_length;
+    double last_motor_time;
+    volatile bool motor_resend;         // Set on (re)connect: the server has not seen a command yet
+
+    // Connection state; commands are only sent while connected. The link is
+    // closed, reopened and written only under send_lock, so a write can never
+    // reach a closed (or already reused) descriptor.
+    char server_address[64];
+    int server_port;
+    atomic_bool connected;
+    ClientMutex send_lock;
+    bool awaiting_frame;                // Set on (re)connect until the first sensor line arrives
+    double outage_start;                // When the current outage was detected
+    ClientStats stats;
+
+    // Optional recordings (NULL when disabled)
+    Recorder* input_recorder;           // Raw sensor lines, written by the receive thread
+    Recorder* output_recorder;          // Commands sent, written by the control thread
+
+    // State marks on their way from the control thread into the input recording
+    // (single producer, single consumer)
+    int32_t state_marks[STATE_MARK_SLOTS];
+    atomic_uint state_mark_head;        // Advanced by the control thread
+    atomic_uint state_mark_tail;        // Advanced by the receive thread
+
+    // PICK / DROP tracking
+    ActionSlot actions[ACTION_SLOTS];
+    ClientMutex action_lock;            // Action counters in stats, updated from both threads
+    ActionId next_action_id;
+    bool action_acks;
+    int action_timeout_ms;
+    int pick_assumed_ms;
+    int drop_assumed_ms;
+
+    RtThreadConfig receive_rt;          // Applied by the receive thread when it starts
+#ifdef _WIN32
+    HANDLE recv_thread;
+#else
+    pthread_t recv_thread;
+#endif
+    bool recv_thread_started;
+};
+
+// ==================== Transports ====================
+
+/**
+ * @brief True if the last failed READ only hit the receive timeout
+ */
+static bool read_timed_out(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAETIMEDOUT;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static int tcp_open(ClientConnection* conn, const char* address, int port) {
+#ifdef _WIN32
+    // Reference counted by Winsock; balanced in tcp_close
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 0;
+#endif
+    SocketType sock = socket(AF_INET, SOCK_STREAM, 0);
+#ifdef _WIN32
+    if (sock == INVALID_SOCKET) {
+        WSACleanup();
+        return 0;
+    }
+    DWORD timeout = RECEIVE_TIMEOUT_MS;
+#else
+    if (sock < 0) return 0;
+    struct timeval timeout;
+    timeout.tv_sec = RECEIVE_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (RECEIVE_TIMEOUT_MS % 1000) * 1000;
+#endif
+    // Bounded reads let the receive thread notice shutdown and stalls
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    // Setup server address structure
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port);
+    inet_pton(AF_INET, address, &serv_addr.sin_addr);
+
+    if (connect(sock, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+        CLOSESOCKET(sock);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return 0;
+    }
+
+    conn->handle = (intptr_t)sock;
+    return 1;
+}
+
+static int tcp_read(ClientConnection* conn, char* buffer, int size) {
+    int n = (int)READ((SocketType)conn->handle, buffer, size);
+    if (n > 0) return n;
+    if (n < 0 && read_timed_out()) return 0;
+    return -1;  // Peer closed the connection or the socket failed
+}
+
+static int tcp_write(ClientConnection* conn, const char* data, int length) {
+    return (int)send((SocketType)conn->handle, data, length, 0);
+}
+
+static void tcp_close(ClientConnection* conn) {
+    CLOSESOCKET((SocketType)conn->handle);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+const ClientTransport tcp_transport = {"tcp", tcp_open, tcp_read, tcp_write, tcp_close};
+
+static int null_open(ClientConnection* conn, const char* address, int port) {
+    (void)conn; (void)address; (void)port;
+    return 1;
+}
+
+static int null_read(ClientConnection* conn, char* buffer, int size) {
+    (void)conn; (void)buffer; (void)size;
+    SLEEP(RECEIVE_TIMEOUT_MS);
+    return 0;
+}
+
+static int null_write(ClientConnection* conn, const char* data, int length) {
+    (void)conn; (void)data;
+    return length;
+}
+
+static void null_close(ClientConnection* conn) {
+    (void)conn;
+}
+
+const ClientTransport null_transport = {"null", null_open, null_read, null_write, null_close};
+
+// ==================== Lifecycle ====================
+
+/**
+ * @brief Releases the receive buffers of a client
+ */
+static void free_client_memory(SocketClient* c) {
+    arena_destroy(&c->rx_arena);
+    c->rx_buffer = NULL;
+    c->line_buffer = NULL;
+}
+
+/**
+ * @brief Allocates the receive buffers of a client
+ * @return 1 on success, 0 if the allocation failed
+ *
+ * All later line handling reuses this memory; frames and commands live on the stack.
+ */
+static int init_client_memory(SocketClient* c) {
+    if (!arena_init(&c->rx_arena, RX_BUFFER_SIZE + LINE_BUFFER_SIZE + 2 * POOL_ALIGNMENT)) {
+        free_client_memory(c);
+        return 0;
+    }
+    c->rx_buffer = (char*)arena_alloc(&c->rx_arena, RX_BUFFER_SIZE);
+    c->line_buffer = (char*)arena_alloc(&c->rx_arena, LINE_BUFFER_SIZE);
+    c->line_pos = 0;
+    return 1;
+}
+
+/**
+ * @brief Fills a configuration with the defaults: TCP to the local simulator, no watchdog or recordings
+ */
+void client_config_init(ClientConfig* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->transport = &tcp_transport;
+    cfg->address = DEFAULT_SERVER_ADDRESS;
+    cfg->port = DEFAULT_SERVER_PORT;
+    cfg->action_timeout_ms = ACTION_TIMEOUT_MS;
+    cfg->pick_assumed_ms = ACTION_PICK_ASSUMED_MS;
+    cfg->drop_assumed_ms = ACTION_DROP_ASSUMED_MS;
+    cfg->motor_refresh_ms = MOTOR_REFRESH_MS;
+}
+
+/**
+ * @brief Allocates a client and preallocates its receive buffers
+ * @param cfg Configuration (NULL = defaults)
+ * @return New client, or NULL if an allocation failed
+ */
+SocketClient* client_create(const ClientConfig* cfg) {
+    ClientConfig defaults;
+    if (!cfg) {
+        client_config_init(&defaults);
+        cfg = &defaults;
+    }
+
+    SocketClient* c = (SocketClient*)calloc(1, sizeof(SocketClient));
+    if (!c) return NULL;
+    if (!init_client_memory(c)) {
+        free(c);
+        return NULL;
+    }
+    MUTEX_INIT(&c->send_lock);
+    MUTEX_INIT(&c->action_lock);
+    atomic_init(&c->connected, false);
+    atomic_init(&c->state_mark_head, 0u);
+    atomic_init(&c->state_mark_tail, 0u);
+
+    c->transport = cfg->transport ? cfg->transport : &tcp_transport;
+    c->conn.state = cfg->transport_state;
+    snprintf(c->server_address, sizeof(c->server_address), "%s", cfg->address ? cfg->address : DEFAULT_SERVER_ADDRESS);
+    c->server_port = cfg->port;
+    c->watchdog = cfg->watchdog;
+    c->input_recorder = cfg->input_recorder;
+    c->output_recorder = cfg->output_recorder;
+    if (cfg->receive_rt) c->receive_rt = *cfg->receive_rt;
+    else rt_thread_config_init(&c->receive_rt);
+    c->speed_scale = 1.0f;
+    c->motor_refresh_ms = cfg->motor_refresh_ms;
+    c->action_acks = cfg->action_acks;
+    c->action_timeout_ms = cfg->action_timeout_ms > 0 ? cfg->action_timeout_ms : ACTION_TIMEOUT_MS;
+    c->pick_assumed_ms = cfg->pick_assumed_ms;
+    c->drop_assumed_ms = cfg->drop_assumed_ms;
+    return c;
+}
+
+/**
+ * @brief Makes one connection attempt to the configured server
+ * @return 1 if connected, 0 otherwise
+ */
+static int open_connection(SocketClient* c) {
+    // Connect outside the lock, so a slow connect does not hold up the control thread
+    ClientConnection conn = c->conn;
+    if (!c->transport->open(&conn, c->server_address, c->server_port)) return 0;
+    c->awaiting_frame = true;
+    c->motor_resend = true;
+    MUTEX_LOCK(&c->send_lock);
+    c->conn = conn;
+    atomic_store(&c->connected, true);
+    MUTEX_UNLOCK(&c->send_lock);
+    return 1;
+}
+
+/**
+ * @brief Closes the link if it is open; senders stop before the descriptor goes away
+ */
+static void close_connection(SocketClient* c) {
+    MUTEX_LOCK(&c->send_lock);
+    if (atomic_load(&c->connected)) {
+        atomic_store(&c->connected, false);
+        c->transport->close(&c->conn);
+    }
+    MUTEX_UNLOCK(&c->send_lock);
+}
+
+/**
+ * @brief Connects to the configured server, retrying with exponential backoff
+ * @param c Pointer to SocketClient structure
+ * @param timeout_ms Give up after this many milliseconds (0 = retry forever)
+ * @return 1 if connected, 0 if the timeout expired or the client was stopped
+ *
+ * The retry delay starts at RECONNECT_INITIAL_DELAY_MS and doubles up to
+ * RECONNECT_MAX_DELAY_MS, which bounds the time between the server coming
+ * back and the client noticing.
+ */
+static int connect_with_backoff(SocketClient* c, int timeout_ms) {
+    double deadline = monotonic_seconds() + timeout_ms / 1000.0;
+    int delay_ms = RECONNECT_INITIAL_DELAY_MS;
+
+    while (!open_connection(c)) {
+        double remaining_ms = (deadline - monotonic_seconds()) * 1000.0;
+        if (timeout_ms > 0 && remaining_ms <= 0) return 0;
+        if (!c->running) return 0;
+
+        int wait_ms = delay_ms;
+        if (timeout_ms > 0 && wait_ms > remaining_ms) wait_ms = (int)remaining_ms + 1;
+        SLEEP(wait_ms);
+
+        delay_ms *= 2;
+        if (delay_ms > RECONNECT_MAX_DELAY_MS) delay_ms = RECONNECT_MAX_DELAY_MS;
+    }
+    return 1;
+}
+
+/**
+ * @brief Connects to the server without starting the receive thread
+ * @param c Pointer to SocketClient structure
+ * @return 1 on success, 0 if no connection could be made within CONNECT_TIMEOUT_MS
+ *
+ * The caller receives sensor data itself with client_poll() (or client_feed()
+ * when replaying).
+ */
+int client_open(SocketClient* c) {
+    c->running = true;
+    if (!connect_with_backoff(c, CONNECT_TIMEOUT_MS)) {
+        printf("Connection failed\n");
+        c->running = false;
+        return 0;
+    }
+    return 1;
+}
+
+static void* receive_loop(void* arg);
+
+/**
+ * @brief Establishes connection to the CoppeliaSim server
+ * @param c Pointer to SocketClient structure
+ * @return 1 on success, 0 on failure
+ *
+ * Retries for up to CONNECT_TIMEOUT_MS, then starts the receive thread,
+ * which keeps the connection alive from then on.
+ */
+int client_connect(SocketClient* c) {
+    if (!client_open(c)) return 0;
+
+    // Start the receive thread to handle incoming sensor data
+#ifdef _WIN32
+    c->recv_thread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)receive_loop, c, 0, NULL);
+#else
+    pthread_create(&c->recv_thread, NULL, receive_loop, c);
+#endif
+    c->recv_thread_started = true;
+    return 1;
+}
+
+/**
+ * @brief Stops the receive thread and closes the connection
+ */
+void disconnect(SocketClient* c) {
+    c->running = false;  // Signal threads to stop
+
+    // Wait for receive thread to finish
+    if (c->recv_thread_started) {
+#ifdef _WIN32
+        WaitForSingleObject(c->recv_thread, INFINITE);
+        CloseHandle(c->recv_thread);
+#else
+        pthread_join(c->recv_thread, NULL);
+#endif
+        c->recv_thread_started = false;
+    }
+
+    close_connection(c);
+}
+
+/**
+ * @brief Disconnects and frees a client
+ */
+void client_destroy(SocketClient* c) {
+    if (!c) return;
+    disconnect(c);
+    free_client_memory(c);
+    MUTEX_DESTROY(&c->send_lock);
+    MUTEX_DESTROY(&c->action_lock);
+    free(c);
+}
+
+// ==================== State ====================
+
+/**
+ * @brief False once the client was stopped or reconnecting gave up
+ */
+bool client_running(const SocketClient* c) {
+    return c->running;
+}
+
+/**
+ * @brief True when the controller may act: connected and fed with fresh data
+ *
+ * Controllers hold still while this is false; their state machine is kept
+ * as is and resumes once the connection is back.
+ */
+bool client_ready(const SocketClient* c) {
+    return atomic_load(&c->connected) && !c->awaiting_frame;
+}
+
+/**
+ * @brief Asks the watchdog how fast the robot may drive given the data age
+ * @param c Pointer to SocketClient structure
+ * @return Speed scale in [0, 1]; 0 means sensor data is too old to move at all
+ *
+ * Called by set_motor for every command; controllers call it once per tick
+ * to skip decisions on stale data.
+ */
+float check_watchdog(SocketClient* c) {
+    if (c->watchdog && c->last_frame_time > 0) {
+        c->speed_scale = watchdog_update(c->watchdog, monotonic_seconds() - c->last_frame_time);
+    }
+    return c->speed_scale;
+}
+
+/**
+ * @brief Connection statistics
+ */
+const ClientStats* client_stats(const SocketClient* c) {
+    return &c->stats;
+}
+
+/**
+ * @brief Indexes a controller state transition in both recordings
+ * @param c Pointer to SocketClient structure
+ * @param state New state
+ *
+ * Control thread only. The mark goes into the output recording at once and
+ * into the input recording just before the next line, so a replay can seek
+ * the sensor stream to it. Marks that find the queue full are counted in
+ * state_marks_dropped.
+ */
+void client_mark_state(SocketClient* c, int32_t state) {
+    if (c->output_recorder) recorder_mark_state(c->output_recorder, monotonic_seconds(), state);
+    if (!c->input_recorder) return;
+
+    unsigned head = atomic_load_explicit(&c->state_mark_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&c->state_mark_tail, memory_order_acquire) >= STATE_MARK_SLOTS) {
+        c->stats.state_marks_dropped++;
+        return;
+    }
+    c->state_marks[head % STATE_MARK_SLOTS] = state;
+    atomic_store_explicit(&c->state_mark_head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Writes the queued state marks into the input recording (receive thread)
+ */
+static void write_state_marks(SocketClient* c) {
+    unsigned tail = atomic_load_explicit(&c->state_mark_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&c->state_mark_head, memory_order_acquire);
+    if (tail == head) return;
+
+    // Stamped now rather than when queued, so the recording stays in time order
+    double now = monotonic_seconds();
+    for (; tail != head; tail++) {
+        recorder_mark_state(c->input_recorder, now, c->state_marks[tail % STATE_MARK_SLOTS]);
+    }
+    atomic_store_explicit(&c->state_mark_tail, tail, memory_order_release);
+}
+
+// ==================== Arm actions (receive side) ====================
+
+/**
+ * @brief Counts a finished action in the client statistics
+ */
+static void count_action(SocketClient* c, ActionStatus status, double elapsed) {
+    MUTEX_LOCK(&c->action_lock);
+    ClientStats* st = &c->stats;
+    if (status == ACTION_DONE) st->actions_done++;
+    else st->actions_failed++;
+    st->last_action_s = elapsed;
+    if (elapsed > st->max_action_s) st->max_action_s = elapsed;
+    MUTEX_UNLOCK(&c->action_lock);
+}
+
+/**
+ * @brief Moves a pending action to its final status and runs its callback
+ */
+static void finish_action(SocketClient* c, ActionSlot* slot, ActionStatus status) {
+    // Read the slot before releasing it; the control thread may reuse it right after
+    ActionId id = atomic_load(&slot->id);
+    double elapsed = monotonic_seconds() - slot->sent_time;
+    ActionCallback callback = slot->callback;
+    void* user = slot->user;
+    ActionStatus expected = ACTION_PENDING;
+    if (!atomic_compare_exchange_strong(&slot->status, &expected, status)) return;  // Finished elsewhere
+
+    count_action(c, status, elapsed);
+    if (callback) callback(id, status, user);
+}
+
+/**
+ * @brief Finishes every pending action whose deadline has passed
+ */
+static void expire_actions(SocketClient* c, double now) {
+    for (int i = 0; i < ACTION_SLOTS; i++) {
+        ActionSlot* slot = &c->actions[i];
+        if (atomic_load(&slot->status) == ACTION_PENDING && now >= slot->deadline) finish_action(c, slot, slot->at_deadline);
+    }
+}
+
+/**
+ * @brief Fails every pending action; the server may have lost them with the connection
+ */
+static void fail_pending_actions(SocketClient* c) {
+    for (int i = 0; i < ACTION_SLOTS; i++) {
+        if (atomic_load(&c->actions[i].status) == ACTION_PENDING) finish_action(c, &c->actions[i], ACTION_FAILED);
+    }
+}
+
+/**
+ * @brief Applies a completion message "A:<id>,OK" or "A:<id>,FAIL" (text after "A:")
+ */
+static void apply_action_reply(SocketClient* c, const char* reply) {
+    char* end = NULL;
+    ActionId id = (ActionId)strtoul(reply, &end, 10);
+    if (id == 0 || end == reply) return;
+
+    ActionSlot* slot = &c->actions[id % ACTION_SLOTS];
+    if (atomic_load(&slot->id) != id || atomic_load(&slot->status) != ACTION_PENDING) return;  // Late answer for an expired action
+    bool ok = *end == ',' && strncmp(end + 1, "OK", 2) == 0;
+    finish_action(c, slot, ok ? ACTION_DONE : ACTION_FAILED);
+}
+
+// ==================== Receive path ====================
+
+/**
+ * @brief Closes a dropped connection and reconnects (receive thread only)
+ * @return 1 if reconnected, 0 if reconnecting gave up or the client stopped
+ */
+static int recover_connection(SocketClient* c) {
+    // Stop senders first so nothing is written to a stale link
+    close_connection(c);
+    c->line_pos = 0;  // Drop the partial line from the old connection
+    fail_pending_actions(c);
+
+    c->stats.disconnects++;
+    c->outage_start = monotonic_seconds();
+    printf("Connection lost, reconnecting to %s:%d...\n", c->server_address, c->server_port);
+
+    if (!connect_with_backoff(c, RECONNECT_TIMEOUT_MS)) {
+        if (c->running) {
+            printf("Reconnect failed after %d ms, stopping\n", RECONNECT_TIMEOUT_MS);
+            c->running = false;
+        }
+        return 0;
+    }
+
+    // Make sure the robot is stopped until the controller has fresh data
+    const char stop[] = "L:0.00;R:0.00\n";
+    MUTEX_LOCK(&c->send_lock);  // Not client_send: the recorder belongs to the control thread
+    c->transport->write(&c->conn, stop, sizeof(stop) - 1);
+    MUTEX_UNLOCK(&c->send_lock);
+    c->stats.reconnects++;
+    return 1;
+}
+
+/**
+ * @brief Parses one sensor line in place
+ * @param line Null-terminated line without the trailing newline (modified)
+ * @param f Frame to fill; only segments present in the line are written
+ * @return Number of segments recognised
+ */
+int parse_sensor_line(char* line, SensorFrame* f) {
+    int segments = 0;
+    char* segment = line;
+    char* next_segment = NULL;
+
+    f->present = 0;
+
+    // Parse each segment separated by semicolon
+    do {
+        next_segment = strchr(segment, ';');
+        if (next_segment) {
+            *next_segment = '\0';
+            next_segment++;
+        }
+
+        if (strncmp(segment, "S:", 2) == 0) {
+            // Line sensor data: "S:val1,val2,val3,val4,val5"
+            char* token = segment + 2;
+            char* next_token = NULL;
+            int idx = 0;
+
+            do {
+                next_token = strchr(token, ',');
+                if (next_token) {
+                    *next_token = '\0';
+                    next_token++;
+                }
+                f->line_sensors[idx++] = (float)atof(token);
+                token = next_token;
+            } while (token && idx < 5);
+
+            // Missing trailing values keep the previous reading
+            f->present |= FRAME_HAS_LINE;
+            for (; idx < 5; idx++) f->line_sensors[idx] = NAN;
+            segments++;
+
+        } else if (strncmp(segment, "P:", 2) == 0) {
+            // Proximity sensor: "P:distance"
+            f->proximity_distance = (float)atof(segment + 2);
+            f->present |= FRAME_HAS_PROXIMITY;
+            segments++;
+
+        } else if (strncmp(segment, "C:", 2) == 0) {
+            // Color sensor: "C:r,g,b"
+            char* r_str = segment + 2;
+            char* g_str = strchr(r_str, ',');
+            char* b_str = NULL;
+
+            if (g_str) {
+                *g_str = '\0';
+                g_str++;
+                b_str = strchr(g_str, ',');
+                if (b_str) {
+                    *b_str = '\0';
+                    b_str++;
+                }
+            }
+
+            f->color_r = (float)atof(r_str);
+            f->color_g = g_str ? (float)atof(g_str) : NAN;
+            f->color_b = b_str ? (float)atof(b_str) : NAN;
+            f->present |= FRAME_HAS_COLOR;
+            segments++;
+        }
+
+        segment = next_segment;
+    } while (segment);
+
+    return segments;
+}
+
+/**
+ * @brief Copies the segments present in a frame into the client's snapshot
+ */
+static void apply_sensor_frame(SocketClient* c, const SensorFrame* f) {
+    ClientSnapshot* s = &c->snapshot;
+    if (f->present & FRAME_HAS_LINE) {
+        for (int i = 0; i < 5; i++) {
+            if (!isnan(f->line_sensors[i])) s->line_sensors[i] = f->line_sensors[i];
+        }
+    }
+    if (f->present & FRAME_HAS_PROXIMITY) {
+        s->proximity_distance = f->proximity_distance;
+    }
+    if (f->present & FRAME_HAS_COLOR) {
+        s->color_r = f->color_r;
+        if (!isnan(f->color_g)) s->color_g = f->color_g;
+        if (!isnan(f->color_b)) s->color_b = f->color_b;
+    }
+}
+
+/**
+ * @brief Completes a (re)connect once sensor data flows again
+ */
+static void note_first_frame(SocketClient* c) {
+    c->awaiting_frame = false;
+    if (c->outage_start > 0) {
+        ClientStats* st = &c->stats;
+        st->last_recovery_s = monotonic_seconds() - c->outage_start;
+        st->total_recovery_s += st->last_recovery_s;
+        if (st->last_recovery_s > st->max_recovery_s) st->max_recovery_s = st->last_recovery_s;
+        c->outage_start = 0;
+        printf("Connection recovered in %.0f ms (max %.0f ms, %u reconnects)\n",
+               st->last_recovery_s * 1000.0, st->max_recovery_s * 1000.0, st->reconnects);
+    }
+}
+
+/**
+ * @brief Splits received bytes into lines and applies each complete sensor line
+ * @param c Pointer to SocketClient structure
+ * @param data Bytes as read from the transport (any chunking)
+ * @param n Number of bytes
+ *
+ * Used by client_poll and by replay tools feeding recorded input. Partial
+ * lines are kept in the client until their newline arrives; lines longer
+ * than LINE_BUFFER_SIZE are truncated.
+ */
+void client_feed(SocketClient* c, const char* data, int n) {
+    char* line_buffer = c->line_buffer;
+    int line_pos = c->line_pos;
+
+    // Process character by character to handle complete lines
+    for (int i = 0; i < n; i++) {
+        if (data[i] == '\n') {
+            // Complete line received; parse it in place (an overlong line is parsed as truncated)
+            if (line_pos > LINE_BUFFER_SIZE - 1) line_pos = LINE_BUFFER_SIZE - 1;
+            line_buffer[line_pos] = '\0';
+
+            // Record the raw line before parsing modifies it, after the state marks it follows
+            if (c->input_recorder) {
+                write_state_marks(c);
+                recorder_append(c->input_recorder, REC_SENSOR_LINE, monotonic_seconds(), line_buffer, line_pos);
+            }
+
+            c->stats.lines_received++;
+            if (line_buffer[0] == 'A' && line_buffer[1] == ':') {
+                apply_action_reply(c, line_buffer + 2);
+            } else {
+                SensorFrame frame;
+                if (parse_sensor_line(line_buffer, &frame) > 0) {
+                    apply_sensor_frame(c, &frame);
+                    c->last_frame_time = monotonic_seconds();
+                    c->stats.frames_received++;
+                    if (c->awaiting_frame) {
+                        note_first_frame(c);
+                    }
+                } else {
+                    c->stats.parse_errors++;
+                }
+            }
+
+            line_pos = 0;  // Reset line buffer
+        } else {
+            // Add character to line buffer
+            if (line_pos < LINE_BUFFER_SIZE - 1) {
+                line_buffer[line_pos++] = data[i];
+            } else if (line_pos == LINE_BUFFER_SIZE - 1) {
+                c->stats.lines_truncated++;
+                line_pos++;  // Count the line once; the rest of it is dropped
+            }
+        }
+    }
+    c->line_pos = line_pos;
+}
+
+/**
+ * @brief Reads once from the transport and applies every complete sensor line
+ * @param c Pointer to SocketClient structure
+ * @return Number of frames applied (0 on a read timeout), -1 if the link was lost
+ *
+ * Waits at most RECEIVE_TIMEOUT_MS. The receive thread calls this in a loop;
+ * a caller that used client_open() calls it itself.
+ */
+int client_poll(SocketClient* c) {
+    if (!atomic_load(&c->connected)) return -1;
+
+    int n = c->transport->read(&c->conn, c->rx_buffer, RX_BUFFER_SIZE - 1);
+    if (n < 0) return -1;
+
+    unsigned long before = c->stats.frames_received;
+    client_feed(c, c->rx_buffer, n);
+    expire_actions(c, monotonic_seconds());
+    return (int)(c->stats.frames_received - before);
+}
+
+/**
+ * @brief Thread function that continuously receives sensor data from the server
+ * @param arg Pointer to SocketClient structure (cast from void*)
+ * @return NULL when thread exits
+ *
+ * Expected data format: "S:val1,val2,val3,val4,val5;P:distance;C:r,g,b\n"
+ */
+static void* receive_loop(void* arg) {
+    SocketClient* c = (SocketClient*)arg;
+    rt_thread_apply(&c->receive_rt, "receive");
+
+    while (c->running) {
+        int n = client_poll(c);
+        if (n < 0) {
+            if (!recover_connection(c)) break;
+        } else if (n > 0) {
+            SLEEP(1);  // Small delay to prevent excessive CPU usage
+        }
+    }
+    return NULL;
+}
+
+// ==================== Send path ====================
+
+/**
+ * @brief Sends one text command and records it
+ * @param c Pointer to SocketClient structure
+ * @param text Command including the trailing newline
+ * @param length Bytes in text
+ * @return Bytes sent, or -1 if not connected or the write failed
+ *
+ * Control thread only (it owns the output recorder).
+ */
+int client_send(SocketClient* c, const char* text, int length) {
+    MUTEX_LOCK(&c->send_lock);
+    if (!atomic_load(&c->connected)) {
+        MUTEX_UNLOCK(&c->send_lock);
+        return -1;
+    }
+    int sent = c->transport->write(&c->conn, text, length);
+    MUTEX_UNLOCK(&c->send_lock);
+
+    if (sent > 0) c->stats.commands_sent++;
+    if (c->output_recorder) {
+        recorder_append(c->output_recorder, REC_COMMAND, monotonic_seconds(), text, length);
+    }
+    return sent;
+}
+
+/**
+ * @brief Sends motor control commands to the robot
+ *
+ * If motor_refresh_ms is set, a command identical to the last one sent is not
+ * written again until that long has passed (counted in motor_coalesced), so
+ * the server receives fewer commands than there are calls.
+ */
+void set_motor(SocketClient* c, float left, float right) {
+    // Slow down or stop if sensor data is getting stale
+    float scale = check_watchdog(c);
+    left *= scale;
+    right *= scale;
+
+    c->snapshot.motor_left = left;
+    c->snapshot.motor_right = right;
+
+    if (atomic_load(&c->connected)) {
+        char text[COMMAND_MAX_LENGTH];
+        int length = snprintf(text, sizeof(text), "L:%.2f;R:%.2f\n", left, right);
+        c->stats.motor_commands++;
+
+        // The server keeps the last command; repeating it only costs bandwidth
+        double now = monotonic_seconds();
+        if (c->motor_refresh_ms > 0 && !c->motor_resend && length == c->last_motor_length &&
+            memcmp(text, c->last_motor, (size_t)length) == 0 &&
+            now - c->last_motor_time < c->motor_refresh_ms / 1000.0) {
+            c->stats.motor_coalesced++;
+        } else if (client_send(c, text, length) > 0) {
+            memcpy(c->last_motor, text, (size_t)length);
+            c->last_motor_length = length;
+            c->last_motor_time = now;
+            c->motor_resend = false;
+        }
+    }
+}
+
+/**
+ * @brief Sends PICK or DROP and starts tracking it (control thread)
+ * @return Action id, or 0 if all slots are busy or the command could not be sent
+ */
+static ActionId start_action(SocketClient* c, const char* verb, int assumed_ms, ActionCallback callback, void* user) {
+    if (!c->running) return 0;
+
+    ActionId id = ++c->next_action_id;
+    if (id == 0) id = ++c->next_action_id;  // 0 means "no action"
+    ActionSlot* slot = &c->actions[id % ACTION_SLOTS];
+    if (atomic_load(&slot->status) == ACTION_PENDING) return 0;
+
+    double now = monotonic_seconds();
+    slot->sent_time = now;
+    slot->callback = callback;
+    slot->user = user;
+    if (c->action_acks) {
+        slot->deadline = now + c->action_timeout_ms / 1000.0;
+        slot->at_deadline = ACTION_TIMED_OUT;
+    } else {
+        slot->deadline = now + assumed_ms / 1000.0;
+        slot->at_deadline = ACTION_DONE;
+    }
+
+    char message[COMMAND_MAX_LENGTH];
+    int length = c->action_acks ? snprintf(message, sizeof(message), "%s:%u\n", verb, id)
+                                : snprintf(message, sizeof(message), "%s\n", verb);
+    bool at_once = !c->action_acks && assumed_ms <= 0;
+    atomic_store(&slot->status, ACTION_NONE);
+    atomic_store(&slot->id, id);
+    // Publish before sending: the answer may arrive before client_send() returns
+    if (!at_once) atomic_store(&slot->status, ACTION_PENDING);
+
+    if (client_send(c, message, length) <= 0) {
+        ActionStatus expected = ACTION_PENDING;
+        if (at_once || atomic_compare_exchange_strong(&slot->status, &expected, ACTION_NONE)) return 0;
+        return id;  // The receive path failed it already (link lost) and ran the callback
+    }
+    c->stats.actions_sent++;
+
+    if (at_once) {
+        atomic_store(&slot->status, ACTION_DONE);  // Counted as done at once; nothing left to track
+        count_action(c, ACTION_DONE, 0.0);
+        if (callback) callback(id, ACTION_DONE, user);
+    }
+    return id;
+}
+
+/**
+ * @brief Starts a pick and tracks its completion
+ * @param c Pointer to SocketClient structure
+ * @param callback Called once when the pick finishes (NULL = poll client_action_status instead)
+ * @param user Passed to the callback
+ * @return Action id, or 0 if the command could not be sent
+ */
+ActionId client_pick(SocketClient* c, ActionCallback callback, void* user) {
+    return start_action(c, "PICK", c->pick_assumed_ms, callback, user);
+}
+
+/**
+ * @brief Starts a drop and tracks its completion; see client_pick()
+ */
+ActionId client_drop(SocketClient* c, ActionCallback callback, void* user) {
+    return start_action(c, "DROP", c->drop_assumed_ms, callback, user);
+}
+
+/**
+ * @brief Current status of an action started by client_pick() / client_drop()
+ *
+ * Does not wait. A pending action whose deadline has passed is reported with
+ * its deadline outcome right away, even if the receive path has not swept
+ * it yet.
+ */
+ActionStatus client_action_status(const SocketClient* c, ActionId id) {
+    if (id == 0) return ACTION_NONE;
+    const ActionSlot* slot = &c->actions[id % ACTION_SLOTS];
+    if (atomic_load(&slot->id) != id) return ACTION_NONE;
+
+    ActionStatus status = atomic_load(&slot->status);
+    if (status == ACTION_PENDING && monotonic_seconds() >= slot->deadline) return slot->at_deadline;
+    return status;
+}
+
+/**
+ * @brief Send pick command to the robot without tracking it
+ * @param c Pointer to SocketClient structure
+ * @return 1 if command sent successfully, 0 if failed
+ */
+int pick_box(SocketClient* c) {
+    return client_pick(c, NULL, NULL) != 0 ? 1 : 0;
+}
+
+/**
+ * @brief Send drop command to the robot without tracking it
+ * @param c Pointer to SocketClient structure
+ * @return 1 if command sent successfully, 0 if failed
+ */
+int drop_box(SocketClient* c) {
+    return client_drop(c, NULL, NULL) != 0 ? 1 : 0;
+}
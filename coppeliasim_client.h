@@ -5,229 +5,219 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "recording.h"
+#include "clock_util.h"
+#include "watchdog.h"
+#include "rt_thread.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
-    #include <ws2tcpip.h>
     #include <windows.h>
-    typedef SOCKET SocketType;
-    #define CLOSESOCKET closesocket
-    #define READ(s, buf, len) recv(s, buf, len, 0)
     #define SLEEP(ms) Sleep(ms)
-    #pragma comment(lib, "Ws2_32.lib")
 #else
     #include <unistd.h>
-    #include <arpa/inet.h>
-    #include <sys/socket.h>
     #include <pthread.h>
-    typedef int SocketType;
-    #define CLOSESOCKET close
-    #define READ(s, buf, len) read(s, buf, len)
     #define SLEEP(ms) usleep((ms) * 1000)
 #endif
 
-// Structure to hold socket client data and sensor information
+/*
+ * Client for the CoppeliaSim robot server.
+ *
+ * The client is an opaque handle implemented in coppeliasim_client.c:
+ *
+ *   client_create()    allocate a client and all of its buffers
+ *   client_connect()   connect and start the receive thread
+ *   client_open()      connect only; the caller drives client_poll()
+ *   client_poll()      read once from the transport and apply complete lines
+ *   client_send()      write one text command (set_motor, pick_box, drop_box)
+ *   client_pick()      start a PICK/DROP arm action and track its completion
+ *   client_destroy()   stop, disconnect and free
+ *
+ * Sensor values are read on the hot path through the static inline accessors
+ * below, without a function call. Bytes move through a ClientTransport, so
+ * other links can be added without touching controller code.
+ *
+ * set_motor() puts every call on the wire by default. With
+ * ClientConfig.motor_refresh_ms above 0, a wheel command equal to the last one
+ * sent is dropped until that long has passed, and always sent after a
+ * (re)connect. A server that treats the command stream as a keep-alive then
+ * sees gaps of up to that long, so coalescing is opt-in.
+ */
+
+// Connection policy
+#define CONNECT_TIMEOUT_MS 2000          // Give up on the initial connection after this long
+#define RECONNECT_TIMEOUT_MS 60000       // Give up reconnecting after this long (0 = never)
+#define RECONNECT_INITIAL_DELAY_MS 50    // First retry delay, doubled after every failure
+#define RECONNECT_MAX_DELAY_MS 1000      // Upper bound on the retry delay
+#define RECEIVE_TIMEOUT_MS 100           // Transport read timeout so the receive thread can react
+#define MOTOR_REFRESH_MS 0               // Default: send every wheel command (no coalescing)
+
+// Arm actions (PICK / DROP)
+#define ACTION_TIMEOUT_MS 3000           // An acknowledged action not answered within this long times out
+#define ACTION_PICK_ASSUMED_MS 500       // Without acknowledgements, a pick counts as done after this long
+#define ACTION_DROP_ASSUMED_MS 1000      // ... and a drop after this long
+
+// Default server address
+#define DEFAULT_SERVER_ADDRESS "127.0.0.1"
+#define DEFAULT_SERVER_PORT 50002
+
+// Flags telling which segments were present in a sensor line
+#define FRAME_HAS_LINE      0x1
+#define FRAME_HAS_PROXIMITY 0x2
+#define FRAME_HAS_COLOR     0x4
+
+// One parsed sensor line: "S:val1,val2,val3,val4,val5;P:distance;C:r,g,b"
+typedef struct {
+    unsigned int present;               // FRAME_HAS_* flags
+    float line_sensors[5];
+    float proximity_distance;
+    float color_r, color_g, color_b;
+} SensorFrame;
+
+typedef struct SocketClient SocketClient;
+
+// Progress of a PICK or DROP
+typedef enum {
+    ACTION_NONE,                        // Unknown id, or its slot was reused
+    ACTION_PENDING,                     // Sent, not finished yet
+    ACTION_DONE,                        // Acknowledged by the server (or assumed done, see ClientConfig)
+    ACTION_FAILED,                      // Server reported failure, or the connection dropped meanwhile
+    ACTION_TIMED_OUT                    // No answer within the action timeout
+} ActionStatus;
+
+typedef unsigned int ActionId;          // 0 = no action
+
+// Called once when an action finishes: on the thread running the receive path, or
+// inside client_pick()/client_drop() for actions that count as done at once
+typedef void (*ActionCallback)(ActionId id, ActionStatus status, void* user);
+
+// Latest sensor readings and wheel commands. Always the first member of a
+// SocketClient, which is what lets the accessors below stay inline.
 typedef struct {
-    SocketType sock;                    
-    bool running;                       
-    
-    // Line sensors (5 sensors)
     float line_sensors[5];              // left_corner, left, middle, right, right_corner
-    
-    // Proximity sensor
     float proximity_distance;           // Proximity sensor raw distance in meters
-    
-    // Color sensor (RGB values)
     float color_r, color_g, color_b;    // RGB color raw values (0.0-1.0)
-    
-#ifdef _WIN32
-    HANDLE recv_thread;                 
-#else
-    pthread_t recv_thread;              
-#endif
-} SocketClient;
+    float motor_left, motor_right;      // Last wheel speeds sent by set_motor, after the watchdog scale
+} ClientSnapshot;
 
-// Function declarations
-void set_motor(SocketClient* c, float left, float right);
+// Connection statistics
+typedef struct {
+    unsigned long frames_received;      // Sensor lines parsed and applied
+    unsigned long lines_received;       // Complete lines of any kind
+    unsigned long parse_errors;         // Lines that were neither a sensor frame nor an acknowledgement
+    unsigned long lines_truncated;      // Lines longer than the line buffer
+    unsigned long commands_sent;
+    unsigned long motor_commands;       // set_motor() calls while connected
+    unsigned long motor_coalesced;      // ... not sent because the same command went out recently
+    unsigned int disconnects;
+    unsigned int reconnects;
+    double last_recovery_s;             // Outage start to first frame after reconnecting
+    double max_recovery_s;
+    double total_recovery_s;
+    unsigned long actions_sent;         // PICK / DROP commands
+    unsigned long actions_done;
+    unsigned long actions_failed;       // Failed or timed out
+    double last_action_s;               // Send to completion of the latest finished action
+    double max_action_s;
+    unsigned long state_marks_dropped;  // State marks lost because the input recording fell behind
+} ClientStats;
+
+// One open link, owned by its transport
+typedef struct {
+    intptr_t handle;                    // Socket or other descriptor
+    void* state;                        // Extra per-connection data, if the transport needs any
+} ClientConnection;
+
+// Transport dispatch table
+typedef struct {
+    const char* name;
+    // Opens a link to address:port; 1 on success, 0 on failure
+    int (*open)(ClientConnection* conn, const char* address, int port);
+    // Bytes read (> 0), 0 if nothing arrived within RECEIVE_TIMEOUT_MS, -1 if the link is lost
+    int (*read)(ClientConnection* conn, char* buffer, int size);
+    // Bytes written, or -1 on failure
+    int (*write)(ClientConnection* conn, const char* data, int length);
+    void (*close)(ClientConnection* conn);
+} ClientTransport;
+
+extern const ClientTransport tcp_transport;    // Text protocol over TCP (default)
+extern const ClientTransport null_transport;   // Reads nothing, accepts every write (replay, benchmarks)
+
+typedef struct {
+    const ClientTransport* transport;   // NULL = tcp_transport
+    void* transport_state;              // Handed to the transport as ClientConnection.state (e.g. a FaultLink)
+    const char* address;
+    int port;
+    Watchdog* watchdog;                 // Stale-data failsafe, checked from the control thread (NULL = off)
+    Recorder* input_recorder;           // Raw sensor lines and state marks, written by the receive thread (NULL = off)
+    Recorder* output_recorder;          // Commands sent and state marks, written by the control thread (NULL = off)
+    const RtThreadConfig* receive_rt;   // Real-time setup of the receive thread (NULL = default attributes)
+
+    // Arm actions. With action_acks the server must answer "PICK:<id>" / "DROP:<id>"
+    // with "A:<id>,OK" or "A:<id>,FAIL"; without it plain "PICK" / "DROP" is sent
+    // and the action counts as done after pick/drop_assumed_ms (0 = at once).
+    bool action_acks;
+    int action_timeout_ms;
+    int pick_assumed_ms;
+    int drop_assumed_ms;
+
+    // If above 0, a wheel command equal to the last one sent is not sent again unless
+    // this long has passed since, so a steady command reaches the server only every
+    // motor_refresh_ms (0 = send every command, the default)
+    int motor_refresh_ms;
+} ClientConfig;
+
+// Lifecycle
+void client_config_init(ClientConfig* cfg);
+SocketClient* client_create(const ClientConfig* cfg);
+int client_open(SocketClient* c);
+int client_connect(SocketClient* c);
 void disconnect(SocketClient* c);
-void* receive_loop(void* arg);
+void client_destroy(SocketClient* c);
+
+// Receive path
+int client_poll(SocketClient* c);
+void client_feed(SocketClient* c, const char* data, int n);
+int parse_sensor_line(char* line, SensorFrame* f);
 
-// Pick and place function declarations
+// Send path
+int client_send(SocketClient* c, const char* text, int length);
+void set_motor(SocketClient* c, float left, float right);
 int pick_box(SocketClient* c);
 int drop_box(SocketClient* c);
 
-// Function implementations
-/**
- * @brief Sends motor control commands to the robot
- */
-void set_motor(SocketClient* c, float left, float right) {
-    if (c->sock != -1) {
-        char cmd[128];
-        snprintf(cmd, sizeof(cmd), "L:%.2f;R:%.2f\n", left, right);
-        send(c->sock, cmd, strlen(cmd), 0);
-    }
-}
+// Arm actions with completion tracking
+ActionId client_pick(SocketClient* c, ActionCallback callback, void* user);
+ActionId client_drop(SocketClient* c, ActionCallback callback, void* user);
+ActionStatus client_action_status(const SocketClient* c, ActionId id);
 
-/**
- * @brief Send pick command to the robot
- * @param c Pointer to SocketClient structure
- * @return 1 if command sent successfully, 0 if failed
- */
-int pick_box(SocketClient* c) {
-    if (!c->running || c->sock == -1) return 0;
-    
-    char message[] = "PICK\n";
-    int bytes_sent = send(c->sock, message, strlen(message), 0);
-    return (bytes_sent > 0) ? 1 : 0;
-}
+// State
+bool client_running(const SocketClient* c);
+bool client_ready(const SocketClient* c);
+float check_watchdog(SocketClient* c);
+const ClientStats* client_stats(const SocketClient* c);
+void client_mark_state(SocketClient* c, int32_t state);
 
 /**
- * @brief Send drop command to the robot
- * @param c Pointer to SocketClient structure
- * @return 1 if command sent successfully, 0 if failed
+ * @brief Latest sensor readings and wheel commands of a client
  */
-int drop_box(SocketClient* c) {
-    if (!c->running || c->sock == -1) return 0;
-    
-    char message[] = "DROP\n";
-    int bytes_sent = send(c->sock, message, strlen(message), 0);
-    return (bytes_sent > 0) ? 1 : 0;
+static inline const ClientSnapshot* client_snapshot(const SocketClient* c) {
+    return (const ClientSnapshot*)(const void*)c;
 }
 
 /**
- * @brief Cleanly disconnects from the server and cleans up resources
+ * @brief The five line sensor readings, left corner first
  */
-void disconnect(SocketClient* c) {
-    c->running = false;  // Signal threads to stop
-    
-    // Wait for receive thread to finish
-#ifdef _WIN32
-    WaitForSingleObject(c->recv_thread, INFINITE);
-#else
-    pthread_join(c->recv_thread, NULL);
-#endif
-    
-    // Close socket if open
-    if (c->sock != -1) {
-        CLOSESOCKET(c->sock);
-        c->sock = -1;
-    }
-    
-    // Cleanup Windows socket library
-#ifdef _WIN32
-    WSACleanup();
-#endif
+static inline const float* client_line_sensors(const SocketClient* c) {
+    return client_snapshot(c)->line_sensors;
 }
 
 /**
- * @brief Thread function that continuously receives sensor data from the server
- * @param arg Pointer to SocketClient structure (cast from void*)
- * @return NULL when thread exits
- * 
- * This function runs in a separate thread and parses incoming sensor data.
- * Expected data formats: 
- * - "S:val1,val2,val3,val4,val5;P:distance;C:r,g,b\n"
+ * @brief Proximity sensor distance in meters
  */
-void* receive_loop(void* arg) {
-    SocketClient* c = (SocketClient*)arg;
-    char buffer[2048];
-    char line_buffer[2048] = {0};
-    int line_pos = 0;
-    
-    while (c->running) {
-        // Read data from socket
-        int n = READ(c->sock, buffer, sizeof(buffer) - 1);
-        if (n > 0) {
-            buffer[n] = '\0';  // Null-terminate the received string
-            
-            // Process character by character to handle complete lines
-            for (int i = 0; i < n; i++) {
-                if (buffer[i] == '\n') {
-                    // Complete line received
-                    line_buffer[line_pos] = '\0';
-                    
-                    // Parse the line: "S:val1,val2,val3,val4,val5;P:distance;C:r,g,b"
-                    char line_copy[2048];
-                    strcpy(line_copy, line_buffer);
-                    
-                    char* segment = line_copy;
-                    char* next_segment = NULL;
-                    
-                    // Parse each segment separated by semicolon
-                    do {
-                        next_segment = strchr(segment, ';');
-                        if (next_segment) {
-                            *next_segment = '\0';
-                            next_segment++;
-                        }
-                        
-                        if (strncmp(segment, "S:", 2) == 0) {
-                            // Line sensor data: "S:val1,val2,val3,val4,val5"
-                            char* values = segment + 2;
-                            char values_copy[256];
-                            strcpy(values_copy, values);
-                            
-                            char* token = values_copy;
-                            char* next_token = NULL;
-                            int idx = 0;
-                            
-                            do {
-                                next_token = strchr(token, ',');
-                                if (next_token) {
-                                    *next_token = '\0';
-                                    next_token++;
-                                }
-                                
-                                if (idx < 5) {
-                                    c->line_sensors[idx++] = (float)atof(token);
-                                }
-                                token = next_token;
-                            } while (token && idx < 5);
-                            
-                        } else if (strncmp(segment, "P:", 2) == 0) {
-                            // Proximity sensor: "P:distance"
-                            c->proximity_distance = (float)atof(segment + 2);
-                            
-                        } else if (strncmp(segment, "C:", 2) == 0) {
-                            // Color sensor: "C:r,g,b"
-                            char* values = segment + 2;
-                            char values_copy[256];
-                            strcpy(values_copy, values);
-                            
-                            char* r_str = values_copy;
-                            char* g_str = strchr(r_str, ',');
-                            char* b_str = NULL;
-                            
-                            if (g_str) {
-                                *g_str = '\0';
-                                g_str++;
-                                b_str = strchr(g_str, ',');
-                                if (b_str) {
-                                    *b_str = '\0';
-                                    b_str++;
-                                }
-                            }
-                            
-                            c->color_r = (float)atof(r_str);
-                            if (g_str) c->color_g = (float)atof(g_str);
-                            if (b_str) c->color_b = (float)atof(b_str);
-                        }
-                        
-                        segment = next_segment;
-                    } while (segment);
-                    
-                    line_pos = 0;  // Reset line buffer
-                } else {
-                    // Add character to line buffer
-                    if (line_pos < sizeof(line_buffer) - 1) {
-                        line_buffer[line_pos++] = buffer[i];
-                    }
-                }
-            }
-        }
-        SLEEP(1);  // Small delay to prevent excessive CPU usage
-    }
-    return NULL;
+static inline float client_proximity(const SocketClient* c) {
+    return client_snapshot(c)->proximity_distance;
 }
 
-#endif // COPPELIASIM_CLIENT_H
\ No newline at end of file
+#endif // COPPELIASIM_CLIENT_H
@@ -0,0 +1,553 @@
+#ifndef FAULT_INJECTION_H
+#define FAULT_INJECTION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "coppeliasim_client.h"
+#include "clock_util.h"
+
+/*
+ * Seeded fault injection between the client and its link.
+ *
+ * A FaultInjector sits on a byte stream in each direction. Bytes are split
+ * into lines, each line is impaired and queued with a release time, and the
+ * reader pulls whatever is due:
+ *
+ *   latency / jitter   every line is held latency + U(0, jitter); the stream
+ *                      keeps its order, a late line holds back the ones after it
+ *   reorder            a line overtakes the one queued before it
+ *   drop               a sensor line is lost (the server skipped a frame)
+ *   truncate           a sensor line is cut short, losing its trailing values
+ *   overlong           junk is inserted before the newline so the line no
+ *                      longer fits the client's line buffer
+ *   split              a read ends in the middle of a line
+ *   noise / bias       added to the line sensor, proximity and color values
+ *   command drop       a wheel command is lost
+ *
+ * Acknowledgements and PICK/DROP commands are only delayed, never dropped or
+ * altered: over TCP bytes are not lost, only frames the server never sent.
+ *
+ * The injector itself takes the time as an argument, so benchmarks on
+ * simulated time stay deterministic. For live runs, a FaultLink wraps another
+ * ClientTransport: set ClientConfig.transport = &fault_transport and
+ * ClientConfig.transport_state to the link. A reader thread stamps incoming
+ * bytes as they arrive, so the delays do not depend on how often the client
+ * polls. Settings come from CB_FAULT_* (see fault_config_from_env()).
+ */
+
+#define FAULT_QUEUE_LINES 256            // Lines in flight per direction; more are dropped and counted
+#define FAULT_LINE_MAX 192               // Longer input lines are cut to this (sensor lines are ~70 bytes)
+#define FAULT_OVERLONG_BYTES 4096        // Junk inserted into an overlong line, more than the client buffers
+
+typedef struct {
+    uint64_t seed;
+
+    // Link, applied in both directions
+    float latency_ms;
+    float jitter_ms;
+    float reorder_rate;
+
+    // Received lines
+    float drop_rate;
+    float truncate_rate;
+    float overlong_rate;
+    float split_rate;
+
+    // Sensor values (standard deviation of the noise, and a constant offset)
+    float line_noise, line_bias;        // IR reading, 0..1
+    float proximity_noise, proximity_bias;  // m
+    float color_noise;
+
+    // Sent commands
+    float command_drop_rate;            // Wheel commands only
+} FaultConfig;
+
+// One line in flight
+typedef struct {
+    double due;
+    int length;                         // Bytes in text, without the newline
+    int pad;                            // Junk bytes before the newline
+    char text[FAULT_LINE_MAX];
+} FaultLine;
+
+// Lines in flight in one direction, oldest first
+typedef struct {
+    FaultLine lines[FAULT_QUEUE_LINES];
+    int head;
+    int count;
+    int offset;                         // Bytes of the head line already delivered
+    int limit;                          // Deliver the head line only up to here in this read (split)
+    char partial[FAULT_LINE_MAX];       // Incoming bytes waiting for their newline
+    int partial_length;
+} FaultQueue;
+
+typedef struct {
+    unsigned long lines;                // Lines seen, both directions
+    unsigned long dropped;
+    unsigned long commands_dropped;
+    unsigned long reordered;
+    unsigned long truncated;
+    unsigned long overlong;
+    unsigned long split;
+    unsigned long perturbed;            // Sensor lines with noise or bias applied
+    unsigned long overflowed;           // Lost because the queue was full
+    double max_delay_s;
+} FaultStats;
+
+typedef struct {
+    FaultConfig config;
+    uint64_t rng;
+    FaultQueue rx;                      // Server to client
+    FaultQueue tx;                      // Client to server
+    FaultStats stats;
+} FaultInjector;
+
+/**
+ * @brief Sets every fault off
+ */
+static inline void fault_config_init(FaultConfig* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->seed = 1;
+}
+
+/**
+ * @brief True if the configuration injects anything at all
+ */
+static inline bool fault_config_active(const FaultConfig* cfg) {
+    return cfg->latency_ms > 0 || cfg->jitter_ms > 0 || cfg->reorder_rate > 0 || cfg->drop_rate > 0 ||
+           cfg->truncate_rate > 0 || cfg->overlong_rate > 0 || cfg->split_rate > 0 || cfg->line_noise > 0 ||
+           cfg->line_bias != 0 || cfg->proximity_noise > 0 || cfg->proximity_bias != 0 || cfg->color_noise > 0 ||
+           cfg->command_drop_rate > 0;
+}
+
+/**
+ * @brief Reads the configuration from the environment
+ * @return true if any fault is enabled
+ *
+ *   CB_FAULT_SEED, CB_FAULT_LATENCY_MS, CB_FAULT_JITTER_MS, CB_FAULT_REORDER,
+ *   CB_FAULT_DROP, CB_FAULT_TRUNCATE, CB_FAULT_OVERLONG, CB_FAULT_SPLIT,
+ *   CB_FAULT_LINE_NOISE, CB_FAULT_LINE_BIAS, CB_FAULT_PROXIMITY_NOISE,
+ *   CB_FAULT_PROXIMITY_BIAS, CB_FAULT_COLOR_NOISE, CB_FAULT_COMMAND_DROP
+ *
+ * Rates are probabilities per line (0..1).
+ */
+static inline bool fault_config_from_env(FaultConfig* cfg) {
+    fault_config_init(cfg);
+    const char* v;
+    if ((v = getenv("CB_FAULT_SEED")) != NULL) cfg->seed = strtoull(v, NULL, 10);
+    if ((v = getenv("CB_FAULT_LATENCY_MS")) != NULL) cfg->latency_ms = (float)atof(v);
+    if ((v = getenv("CB_FAULT_JITTER_MS")) != NULL) cfg->jitter_ms = (float)atof(v);
+    if ((v = getenv("CB_FAULT_REORDER")) != NULL) cfg->reorder_rate = (float)atof(v);
+    if ((v = getenv("CB_FAULT_DROP")) != NULL) cfg->drop_rate = (float)atof(v);
+    if ((v = getenv("CB_FAULT_TRUNCATE")) != NULL) cfg->truncate_rate = (float)atof(v);
+    if ((v = getenv("CB_FAULT_OVERLONG")) != NULL) cfg->overlong_rate = (float)atof(v);
+    if ((v = getenv("CB_FAULT_SPLIT")) != NULL) cfg->split_rate = (float)atof(v);
+    if ((v = getenv("CB_FAULT_LINE_NOISE")) != NULL) cfg->line_noise = (float)atof(v);
+    if ((v = getenv("CB_FAULT_LINE_BIAS")) != NULL) cfg->line_bias = (float)atof(v);
+    if ((v = getenv("CB_FAULT_PROXIMITY_NOISE")) != NULL) cfg->proximity_noise = (float)atof(v);
+    if ((v = getenv("CB_FAULT_PROXIMITY_BIAS")) != NULL) cfg->proximity_bias = (float)atof(v);
+    if ((v = getenv("CB_FAULT_COLOR_NOISE")) != NULL) cfg->color_noise = (float)atof(v);
+    if ((v = getenv("CB_FAULT_COMMAND_DROP")) != NULL) cfg->command_drop_rate = (float)atof(v);
+    return fault_config_active(cfg);
+}
+
+/**
+ * @brief Prints the enabled faults on one line
+ */
+static inline void fault_config_print(const FaultConfig* cfg, const char* name) {
+    printf("%s: seed %llu, latency %.1f+%.1f ms, reorder %.3f, drop %.3f, truncate %.3f, overlong %.3f, "
+           "split %.3f, noise line %.3f%+.3f prox %.4f%+.4f color %.3f, command drop %.3f\n",
+           name, (unsigned long long)cfg->seed, cfg->latency_ms, cfg->jitter_ms, cfg->reorder_rate, cfg->drop_rate,
+           cfg->truncate_rate, cfg->overlong_rate, cfg->split_rate, cfg->line_noise, cfg->line_bias,
+           cfg->proximity_noise, cfg->proximity_bias, cfg->color_noise, cfg->command_drop_rate);
+}
+
+/**
+ * @brief Starts an injector with empty queues
+ */
+static inline void fault_injector_init(FaultInjector* f, const FaultConfig* cfg) {
+    memset(f, 0, sizeof(*f));
+    f->config = *cfg;
+    f->rng = cfg->seed * 0x9E3779B97F4A7C15ull + 1;
+}
+
+/**
+ * @brief Drops everything in flight (a new connection starts empty)
+ */
+static inline void fault_injector_reset(FaultInjector* f) {
+    memset(&f->rx, 0, sizeof(f->rx));
+    memset(&f->tx, 0, sizeof(f->tx));
+}
+
+/**
+ * @brief Uniform random number in [0, 1) (xorshift64*)
+ */
+static inline double fault_uniform(FaultInjector* f) {
+    f->rng ^= f->rng >> 12;
+    f->rng ^= f->rng << 25;
+    f->rng ^= f->rng >> 27;
+    return (double)((f->rng * 0x2545F4914F6CDD1Dull) >> 11) / 9007199254740992.0;
+}
+
+static inline bool fault_chance(FaultInjector* f, float rate) {
+    return rate > 0 && fault_uniform(f) < rate;
+}
+
+/**
+ * @brief Normal random number with the given standard deviation (Box-Muller)
+ */
+static inline float fault_gaussian(FaultInjector* f, float sigma) {
+    if (sigma <= 0) return 0;
+    double u = fault_uniform(f);
+    double v = fault_uniform(f);
+    return (float)(sigma * sqrt(-2.0 * log(1.0 - u)) * cos(6.283185307179586 * v));
+}
+
+/**
+ * @brief Adds noise and bias to the values of a sensor line in place
+ * @return 1 if the line was rewritten, 0 if it was left alone
+ */
+static inline int fault_perturb_line(FaultInjector* f, char* text, int* length) {
+    const FaultConfig* cfg = &f->config;
+    if (cfg->line_noise <= 0 && cfg->line_bias == 0 && cfg->proximity_noise <= 0 && cfg->proximity_bias == 0 &&
+        cfg->color_noise <= 0) {
+        return 0;
+    }
+
+    char copy[FAULT_LINE_MAX + 1];
+    memcpy(copy, text, (size_t)*length);
+    copy[*length] = '\0';
+    SensorFrame frame;
+    if (parse_sensor_line(copy, &frame) <= 0) return 0;
+
+    // Only complete segments are rewritten; anything else is passed on unchanged
+    char out[FAULT_LINE_MAX];
+    int n = 0;
+    if (frame.present & FRAME_HAS_LINE) {
+        float* s = frame.line_sensors;
+        for (int i = 0; i < 5; i++) {
+            if (isnan(s[i])) return 0;
+            s[i] += cfg->line_bias + fault_gaussian(f, cfg->line_noise);
+        }
+        n += snprintf(out + n, sizeof(out) - n, "S:%.3f,%.3f,%.3f,%.3f,%.3f", s[0], s[1], s[2], s[3], s[4]);
+    }
+    if (frame.present & FRAME_HAS_PROXIMITY) {
+        float p = frame.proximity_distance + cfg->proximity_bias + fault_gaussian(f, cfg->proximity_noise);
+        n += snprintf(out + n, sizeof(out) - n, "%sP:%.4f", n ? ";" : "", p);
+    }
+    if (frame.present & FRAME_HAS_COLOR) {
+        if (isnan(frame.color_g) || isnan(frame.color_b)) return 0;
+        n += snprintf(out + n, sizeof(out) - n, "%sC:%.3f,%.3f,%.3f", n ? ";" : "",
+                      frame.color_r + fault_gaussian(f, cfg->color_noise),
+                      frame.color_g + fault_gaussian(f, cfg->color_noise),
+                      frame.color_b + fault_gaussian(f, cfg->color_noise));
+    }
+    if (n <= 0 || n >= (int)sizeof(out)) return 0;
+    memcpy(text, out, (size_t)n);
+    *length = n;
+    return 1;
+}
+
+/**
+ * @brief Impairs one complete line and queues it
+ * @param f Pointer to FaultInjector structure
+ * @param q Direction the line travels in (&f->rx or &f->tx)
+ * @param text Line without the newline
+ * @param length Bytes in text (at most FAULT_LINE_MAX)
+ * @param now Time in seconds
+ */
+static inline void fault_queue_line(FaultInjector* f, FaultQueue* q, const char* text, int length, double now) {
+    const FaultConfig* cfg = &f->config;
+    bool received = q == &f->rx;
+    f->stats.lines++;
+
+    FaultLine line;
+    line.length = length;
+    line.pad = 0;
+    memcpy(line.text, text, (size_t)length);
+
+    if (received) {
+        if (length < 2 || text[0] != 'A' || text[1] != ':') {
+            if (fault_chance(f, cfg->drop_rate)) {
+                f->stats.dropped++;
+                return;
+            }
+            if (fault_perturb_line(f, line.text, &line.length)) f->stats.perturbed++;
+            if (line.length > 1 && fault_chance(f, cfg->truncate_rate)) {
+                line.length = 1 + (int)(fault_uniform(f) * (line.length - 1));
+                f->stats.truncated++;
+            }
+            if (fault_chance(f, cfg->overlong_rate)) {
+                line.pad = FAULT_OVERLONG_BYTES;
+                f->stats.overlong++;
+            }
+        }
+    } else if (length >= 2 && text[0] == 'L' && text[1] == ':' && fault_chance(f, cfg->command_drop_rate)) {
+        f->stats.commands_dropped++;
+        return;
+    }
+
+    if (q->count == FAULT_QUEUE_LINES) {
+        f->stats.overflowed++;
+        return;
+    }
+
+    // A stream link delivers in order: a line is never due before the one ahead of it
+    double delay = (cfg->latency_ms + cfg->jitter_ms * fault_uniform(f)) / 1000.0;
+    line.due = now + delay;
+    int tail = (q->head + q->count - 1) % FAULT_QUEUE_LINES;
+    if (q->count > 0 && q->lines[tail].due > line.due) line.due = q->lines[tail].due;
+    if (line.due - now > f->stats.max_delay_s) f->stats.max_delay_s = line.due - now;
+
+    // Overtake the previous line if it has not started to go out yet
+    int slot = (q->head + q->count) % FAULT_QUEUE_LINES;
+    if (q->count > 0 && !(tail == q->head && q->offset > 0) && fault_chance(f, cfg->reorder_rate)) {
+        q->lines[slot] = q->lines[tail];
+        slot = tail;
+        f->stats.reordered++;
+    }
+    q->lines[slot] = line;
+    q->count++;
+}
+
+/**
+ * @brief Feeds bytes entering the link in one direction
+ * @param f Pointer to FaultInjector structure
+ * @param q &f->rx for bytes from the server, &f->tx for bytes to it
+ * @param data Bytes in any chunking
+ * @param n Number of bytes
+ * @param now Time in seconds
+ */
+static inline void fault_push(FaultInjector* f, FaultQueue* q, const char* data, int n, double now) {
+    for (int i = 0; i < n; i++) {
+        if (data[i] == '\n') {
+            fault_queue_line(f, q, q->partial, q->partial_length, now);
+            q->partial_length = 0;
+        } else if (q->partial_length < FAULT_LINE_MAX) {
+            q->partial[q->partial_length++] = data[i];
+        }
+    }
+}
+
+/**
+ * @brief Byte i of a queued line, junk and newline included
+ */
+static inline char fault_line_byte(const FaultLine* line, int i) {
+    if (i < line->length) return line->text[i];
+    i -= line->length;
+    if (i < line->pad) return i == 0 ? ';' : (i == 1 ? 'X' : (i == 2 ? ':' : 'x'));
+    return '\n';
+}
+
+/**
+ * @brief Takes the bytes that are due out of the link in one direction
+ * @param f Pointer to FaultInjector structure
+ * @param q Direction to read
+ * @param buffer Receives the bytes
+ * @param size Capacity of buffer
+ * @param now Time in seconds
+ * @return Bytes written to buffer (0 if nothing is due)
+ */
+static inline int fault_pull(FaultInjector* f, FaultQueue* q, char* buffer, int size, double now) {
+    int n = 0;
+    while (n < size && q->count > 0 && q->lines[q->head].due <= now) {
+        FaultLine* line = &q->lines[q->head];
+        int total = line->length + line->pad + 1;
+        if (q->offset == 0) {
+            q->limit = total;
+            if (q == &f->rx && total > 1 && fault_chance(f, f->config.split_rate)) {
+                q->limit = 1 + (int)(fault_uniform(f) * (total - 1));
+                f->stats.split++;
+            }
+        }
+
+        int end = q->limit;
+        if (end - q->offset > size - n) end = q->offset + (size - n);
+        for (int i = q->offset; i < end; i++) buffer[n++] = fault_line_byte(line, i);
+        q->offset = end;
+
+        if (q->offset == total) {
+            q->head = (q->head + 1) % FAULT_QUEUE_LINES;
+            q->count--;
+            q->offset = 0;
+        } else if (q->offset == q->limit) {
+            q->limit = total;  // The rest goes out with the next read
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Prints what was injected
+ */
+static inline void fault_injector_report(const FaultInjector* f, const char* name) {
+    const FaultStats* s = &f->stats;
+    printf("%s: %lu lines, %lu dropped, %lu commands dropped, %lu reordered, %lu truncated, %lu overlong, "
+           "%lu split, %lu perturbed, %lu queue overflows, max delay %.1f ms\n",
+           name, s->lines, s->dropped, s->commands_dropped, s->reordered, s->truncated, s->overlong, s->split,
+           s->perturbed, s->overflowed, s->max_delay_s * 1000.0);
+}
+
+// ==================== Live transport ====================
+
+typedef struct {
+    FaultInjector injector;
+    const ClientTransport* inner;       // The real link
+    ClientConnection conn;              // Its connection
+    volatile bool running;
+    volatile bool lost;                 // The inner link failed; reported once the queue is empty
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    HANDLE reader;
+#else
+    pthread_mutex_t lock;
+    pthread_t reader;
+#endif
+} FaultLink;
+
+static inline void fault_link_lock(FaultLink* l) {
+#ifdef _WIN32
+    EnterCriticalSection(&l->lock);
+#else
+    pthread_mutex_lock(&l->lock);
+#endif
+}
+
+static inline void fault_link_unlock(FaultLink* l) {
+#ifdef _WIN32
+    LeaveCriticalSection(&l->lock);
+#else
+    pthread_mutex_unlock(&l->lock);
+#endif
+}
+
+/**
+ * @brief Creates a link that impairs another transport
+ * @param inner Transport carrying the bytes (NULL = tcp_transport)
+ * @param cfg Faults to inject
+ * @return New link, or NULL if the allocation failed
+ */
+static inline FaultLink* fault_link_create(const ClientTransport* inner, const FaultConfig* cfg) {
+    FaultLink* l = (FaultLink*)calloc(1, sizeof(FaultLink));
+    if (!l) return NULL;
+    fault_injector_init(&l->injector, cfg);
+    l->inner = inner ? inner : &tcp_transport;
+#ifdef _WIN32
+    InitializeCriticalSection(&l->lock);
+#else
+    pthread_mutex_init(&l->lock, NULL);
+#endif
+    return l;
+}
+
+static inline void fault_link_destroy(FaultLink* l) {
+    if (!l) return;
+#ifdef _WIN32
+    DeleteCriticalSection(&l->lock);
+#else
+    pthread_mutex_destroy(&l->lock);
+#endif
+    free(l);
+}
+
+/**
+ * @brief Writes the commands that are due to the inner link (lock held)
+ * @return 0 if the inner write failed, 1 otherwise
+ */
+static inline int fault_link_flush(FaultLink* l, double now) {
+    char buffer[512];
+    int n;
+    while ((n = fault_pull(&l->injector, &l->injector.tx, buffer, (int)sizeof(buffer), now)) > 0) {
+        if (l->inner->write(&l->conn, buffer, n) < 0) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reader thread: stamps incoming bytes on arrival
+ */
+#ifdef _WIN32
+static inline DWORD WINAPI fault_link_reader(LPVOID arg) {
+#else
+static inline void* fault_link_reader(void* arg) {
+#endif
+    FaultLink* l = (FaultLink*)arg;
+    char buffer[2048];
+    while (l->running) {
+        int n = l->inner->read(&l->conn, buffer, (int)sizeof(buffer));
+        if (n < 0) {
+            l->lost = true;
+            break;
+        }
+        if (n > 0) {
+            fault_link_lock(l);
+            fault_push(&l->injector, &l->injector.rx, buffer, n, monotonic_seconds());
+            fault_link_unlock(l);
+        }
+    }
+    return 0;
+}
+
+static inline int fault_open(ClientConnection* conn, const char* address, int port) {
+    FaultLink* l = (FaultLink*)conn->state;
+    if (!l || !l->inner->open(&l->conn, address, port)) return 0;
+    fault_injector_reset(&l->injector);
+    l->lost = false;
+    l->running = true;
+#ifdef _WIN32
+    l->reader = CreateThread(NULL, 0, fault_link_reader, l, 0, NULL);
+#else
+    pthread_create(&l->reader, NULL, fault_link_reader, l);
+#endif
+    return 1;
+}
+
+// Waits up to RECEIVE_TIMEOUT_MS for due bytes, sending due commands meanwhile
+static inline int fault_read(ClientConnection* conn, char* buffer, int size) {
+    FaultLink* l = (FaultLink*)conn->state;
+    double deadline = monotonic_seconds() + RECEIVE_TIMEOUT_MS / 1000.0;
+    for (;;) {
+        double now = monotonic_seconds();
+        fault_link_lock(l);
+        fault_link_flush(l, now);
+        int n = fault_pull(&l->injector, &l->injector.rx, buffer, size, now);
+        bool drained = l->injector.rx.count == 0;
+        fault_link_unlock(l);
+        if (n > 0) return n;
+        if (l->lost && drained) return -1;
+        if (now >= deadline) return 0;
+        SLEEP(1);
+    }
+}
+
+static inline int fault_write(ClientConnection* conn, const char* data, int length) {
+    FaultLink* l = (FaultLink*)conn->state;
+    double now = monotonic_seconds();
+    fault_link_lock(l);
+    fault_push(&l->injector, &l->injector.tx, data, length, now);
+    int ok = fault_link_flush(l, now);
+    fault_link_unlock(l);
+    return ok ? length : -1;
+}
+
+static inline void fault_close(ClientConnection* conn) {
+    FaultLink* l = (FaultLink*)conn->state;
+    l->running = false;
+#ifdef _WIN32
+    WaitForSingleObject(l->reader, INFINITE);
+    CloseHandle(l->reader);
+#else
+    pthread_join(l->reader, NULL);
+#endif
+    l->inner->close(&l->conn);
+}
+
+// Impairs the transport in its FaultLink; ClientConfig.transport_state must point to the link
+static const ClientTransport fault_transport = {"fault", fault_open, fault_read, fault_write, fault_close};
+
+#endif // FAULT_INJECTION_H
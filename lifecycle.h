@@ -0,0 +1,131 @@
+#ifndef LIFECYCLE_H
+#define LIFECYCLE_H
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <signal.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <poll.h>
+#endif
+
+/*
+ * Process lifecycle: turns SIGINT/SIGTERM (Ctrl+C / console close on Windows)
+ * into an orderly stop request that any thread can poll or wait on.
+ *
+ * On POSIX the signal handler writes one byte to a self-pipe. The byte is
+ * never read back, so once a stop is requested the pipe stays readable and
+ * every waiter wakes up immediately from then on.
+ */
+
+#ifdef _WIN32
+static volatile LONG lifecycle_stop_flag = 0;
+static HANDLE lifecycle_event = NULL;
+
+static BOOL WINAPI lifecycle_console_handler(DWORD type) {
+    if (type == CTRL_C_EVENT || type == CTRL_BREAK_EVENT || type == CTRL_CLOSE_EVENT) {
+        InterlockedExchange(&lifecycle_stop_flag, 1);
+        SetEvent(lifecycle_event);
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+static volatile sig_atomic_t lifecycle_stop_flag = 0;
+static int lifecycle_pipe[2] = {-1, -1};
+
+static void lifecycle_signal_handler(int sig) {
+    (void)sig;
+    lifecycle_stop_flag = 1;
+    if (lifecycle_pipe[1] != -1) {
+        char byte = 1;
+        ssize_t ignored = write(lifecycle_pipe[1], &byte, 1);  // Async-signal-safe
+        (void)ignored;
+    }
+}
+#endif
+
+/**
+ * @brief Installs the stop handlers; call once from main before starting threads
+ * @return 1 on success, 0 if the handlers could not be installed
+ */
+static inline int lifecycle_init(void) {
+#ifdef _WIN32
+    lifecycle_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!lifecycle_event) return 0;
+    return SetConsoleCtrlHandler(lifecycle_console_handler, TRUE) ? 1 : 0;
+#else
+    if (pipe(lifecycle_pipe) != 0) return 0;
+    fcntl(lifecycle_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(lifecycle_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(lifecycle_pipe[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction sa;
+    sa.sa_handler = lifecycle_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGINT, &sa, NULL) != 0 || sigaction(SIGTERM, &sa, NULL) != 0) return 0;
+
+    // A send() to a dropped connection must fail with EPIPE, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    return 1;
+#endif
+}
+
+/**
+ * @brief True once a stop was requested by a signal or lifecycle_request_stop()
+ */
+static inline bool lifecycle_stop_requested(void) {
+    return lifecycle_stop_flag != 0;
+}
+
+/**
+ * @brief Requests a stop from inside the program (e.g. after losing the server)
+ */
+static inline void lifecycle_request_stop(void) {
+#ifdef _WIN32
+    InterlockedExchange(&lifecycle_stop_flag, 1);
+    if (lifecycle_event) SetEvent(lifecycle_event);
+#else
+    lifecycle_signal_handler(0);
+#endif
+}
+
+/**
+ * @brief Descriptor that becomes readable once a stop is requested, for poll()
+ * @return File descriptor, or -1 on Windows or before lifecycle_init()
+ */
+static inline int lifecycle_fd(void) {
+#ifdef _WIN32
+    return -1;
+#else
+    return lifecycle_pipe[0];
+#endif
+}
+
+/**
+ * @brief Sleeps for up to ms milliseconds, waking early on a stop request
+ * @return true if a stop was requested
+ */
+static inline bool lifecycle_wait(int ms) {
+    if (lifecycle_stop_requested()) return true;
+#ifdef _WIN32
+    if (lifecycle_event) WaitForSingleObject(lifecycle_event, (DWORD)ms);
+    else Sleep(ms);
+#else
+    if (lifecycle_pipe[0] != -1) {
+        struct pollfd pfd;
+        pfd.fd = lifecycle_pipe[0];
+        pfd.events = POLLIN;
+        poll(&pfd, 1, ms);
+    } else {
+        usleep(ms * 1000);
+    }
+#endif
+    return lifecycle_stop_requested();
+}
+
+#endif // LIFECYCLE_H
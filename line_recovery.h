@@ -0,0 +1,216 @@
+#ifndef LINE_RECOVERY_H
+#define LINE_RECOVERY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+
+/*
+ * Lost-line recovery for the line-following controllers.
+ *
+ * While the line is tracked the controller feeds every line position into a
+ * short history. When the line is lost, the history says on which side it
+ * went: the most recent position, extrapolated along its trend. A loss
+ * shorter than LINE_RECOVERY_GRACE_S leaves the controller's own command in
+ * place, so a dropout or a quick swing over the line does not start a turn.
+ * The search then escalates through three stages:
+ *
+ *   ARC     keep driving forward and curve towards that side, tighter the
+ *           longer the line stays lost, ending in a pivot
+ *   SWEEP   pivot back and forth around the heading, each sweep twice as
+ *           long as the previous one, starting with the other side
+ *   SPIRAL  after the timeout: the loss is reported as a failure, and the
+ *           robot drives an outward spiral towards that side, so it covers
+ *           new ground until the line crosses a sensor again
+ *
+ * Every loss is an episode; its duration is counted when the line comes back
+ * so runs can report how long recoveries take. The timeout can be overridden
+ * with CB_RECOVERY_TIMEOUT_MS.
+ *
+ * Line positions use the line_centroid_error() convention (+ = line right).
+ */
+
+#define LINE_RECOVERY_HISTORY 8          // Line positions kept while tracking
+#define LINE_RECOVERY_MEMORY_S 1.0       // Older positions say nothing about the loss
+#define LINE_RECOVERY_LOOKAHEAD_S 0.1f   // Trend extrapolation when choosing the side
+#define LINE_RECOVERY_DEADBAND 0.1f      // Smaller |position| leaves the side undecided
+#define LINE_RECOVERY_GRACE_S 0.1        // Shorter losses keep the controller's command
+#define LINE_RECOVERY_ARC_S 0.8          // Duration of the arc stage
+#define LINE_RECOVERY_SWEEP_S 0.3        // First sweep; each following one is twice as long
+#define LINE_RECOVERY_TIMEOUT_S 4.0      // Loss duration after which the loss counts as a failure
+#define LINE_RECOVERY_SPIRAL_S 2.0       // Spiral time after which the inner wheel runs at half speed
+
+typedef enum {
+    RECOVERY_TRACKING,                  // Line seen, no search in progress
+    RECOVERY_ARC,
+    RECOVERY_SWEEP,
+    RECOVERY_SPIRAL
+} RecoveryStage;
+
+typedef struct {
+    // History of tracked line positions (ring buffer)
+    float position[LINE_RECOVERY_HISTORY];
+    double time[LINE_RECOVERY_HISTORY];
+    int head;
+    int count;
+
+    // Current episode
+    RecoveryStage stage;
+    int side;                           // +1 search right, -1 search left
+    double lost_since;
+    double timeout_s;
+
+    // Metrics
+    unsigned long losses;
+    unsigned long recoveries;
+    unsigned long failures;             // Episodes that outlasted the timeout (RECOVERY_SPIRAL)
+    unsigned long sweeps;               // Episodes that escalated past the arc
+    unsigned long guessed_sides;        // Episodes without a usable history
+    double total_recovery_s;
+    double max_recovery_s;
+} LineRecovery;
+
+/**
+ * @brief Initializes the recovery with an empty history and the CB_RECOVERY_TIMEOUT_MS override
+ */
+static inline void line_recovery_init(LineRecovery* r) {
+    memset(r, 0, sizeof(*r));
+    r->side = 1;
+    r->timeout_s = LINE_RECOVERY_TIMEOUT_S;
+    const char* v = getenv("CB_RECOVERY_TIMEOUT_MS");
+    if (v && atoi(v) > 0) r->timeout_s = atoi(v) / 1000.0;
+}
+
+/**
+ * @brief Side of the line according to the history, or 0 if it does not tell
+ */
+static inline int line_recovery_guess_side(const LineRecovery* r, double now) {
+    if (r->count == 0) return 0;
+    int last = (r->head + LINE_RECOVERY_HISTORY - 1) % LINE_RECOVERY_HISTORY;
+    if (now - r->time[last] > LINE_RECOVERY_MEMORY_S) return 0;
+
+    // Oldest position still inside the memory window, for the trend
+    int first = last;
+    for (int i = 1; i < r->count; i++) {
+        int k = (last + LINE_RECOVERY_HISTORY - i) % LINE_RECOVERY_HISTORY;
+        if (now - r->time[k] > LINE_RECOVERY_MEMORY_S) break;
+        first = k;
+    }
+    float estimate = r->position[last];
+    double span = r->time[last] - r->time[first];
+    if (span > 0) {
+        float trend = (float)((r->position[last] - r->position[first]) / span);
+        estimate += trend * LINE_RECOVERY_LOOKAHEAD_S;
+    }
+    if (estimate > LINE_RECOVERY_DEADBAND) return 1;
+    if (estimate < -LINE_RECOVERY_DEADBAND) return -1;
+    return 0;
+}
+
+/**
+ * @brief Feeds one sensor frame
+ * @param r Pointer to LineRecovery structure
+ * @param seen true if the controller is tracking the line in this frame
+ * @param position line_centroid_error() of the frame
+ * @param now Time in seconds (any monotonic base, e.g. control time)
+ * @return 1 if this frame ended a loss episode, 0 otherwise
+ */
+static inline int line_recovery_observe(LineRecovery* r, bool seen, float position, double now) {
+    if (!seen) return 0;
+
+    r->position[r->head] = position;
+    r->time[r->head] = now;
+    r->head = (r->head + 1) % LINE_RECOVERY_HISTORY;
+    if (r->count < LINE_RECOVERY_HISTORY) r->count++;
+
+    if (r->stage == RECOVERY_TRACKING) return 0;
+    double duration = now - r->lost_since;
+    r->stage = RECOVERY_TRACKING;
+    r->recoveries++;
+    r->total_recovery_s += duration;
+    if (duration > r->max_recovery_s) r->max_recovery_s = duration;
+    return 1;
+}
+
+/**
+ * @brief Wheel commands for one tick without the line; starts an episode on the first call
+ * @param r Pointer to LineRecovery structure
+ * @param now Time in seconds, same base as line_recovery_observe()
+ * @param speed Forward wheel command of the arc
+ * @param turn_speed Wheel command of a pivot
+ * @param left Holds the controller's left command; receives the search command
+ * @param right Holds the controller's right command; receives the search command
+ * @return Stage of the search
+ */
+static inline RecoveryStage line_recovery_steer(LineRecovery* r, double now, float speed, float turn_speed,
+                                                float* left, float* right) {
+    if (r->stage == RECOVERY_TRACKING) {
+        int side = line_recovery_guess_side(r, now);
+        if (side == 0) {
+            r->guessed_sides++;
+            side = r->side;  // Same side as the last episode
+        }
+        r->side = side;
+        r->stage = RECOVERY_ARC;
+        r->lost_since = now;
+        r->losses++;
+    }
+
+    double t = now - r->lost_since;
+    if (r->stage != RECOVERY_SPIRAL && t >= r->timeout_s) {
+        r->stage = RECOVERY_SPIRAL;
+        r->failures++;
+    } else if (r->stage == RECOVERY_ARC && t >= LINE_RECOVERY_ARC_S) {
+        r->stage = RECOVERY_SWEEP;
+        r->sweeps++;
+    }
+
+    // Within the grace period the controller's command stands
+    if (r->stage == RECOVERY_ARC && t < LINE_RECOVERY_GRACE_S) return r->stage;
+
+    float outer = 0, inner = 0;
+    if (r->stage == RECOVERY_ARC) {
+        // Inner wheel slows from straight ahead to a pivot over the arc
+        float f = (float)(t / LINE_RECOVERY_ARC_S);
+        outer = speed;
+        inner = speed - f * (speed + turn_speed);
+    } else if (r->stage == RECOVERY_SWEEP) {
+        // Sweeps of d, 2d, 4d, ... alternating sides, the first towards the other side
+        double s = t - LINE_RECOVERY_ARC_S;
+        double d = LINE_RECOVERY_SWEEP_S;
+        int k = 0;
+        while (s >= d) {
+            s -= d;
+            d *= 2;
+            k++;
+        }
+        float dir = (k % 2 == 0) ? -1.0f : 1.0f;
+        outer = dir * turn_speed;
+        inner = -dir * turn_speed;
+    } else {
+        // Pivoting in place cannot reach a line out of sight: widen the turn as time
+        // goes on, so the robot spirals outwards instead of stopping for good
+        double u = t - r->timeout_s;
+        outer = speed;
+        inner = speed * (float)(u / (u + LINE_RECOVERY_SPIRAL_S));
+    }
+
+    // Line to the right: the left wheel is the outer one
+    *left = r->side > 0 ? outer : inner;
+    *right = r->side > 0 ? inner : outer;
+    return r->stage;
+}
+
+/**
+ * @brief Prints loss, recovery and failure counts and the recovery times
+ */
+static inline void line_recovery_report(const LineRecovery* r, const char* name) {
+    if (r->losses == 0) return;
+    printf("%s: %lu line losses, %lu recovered (mean %.0f ms, max %.0f ms), %lu swept, %lu failed, %lu side guesses\n",
+           name, r->losses, r->recoveries, r->recoveries ? 1000.0 * r->total_recovery_s / r->recoveries : 0.0,
+           1000.0 * r->max_recovery_s, r->sweeps, r->failures, r->guessed_sides);
+}
+
+#endif // LINE_RECOVERY_H
@@ -0,0 +1,89 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// All arena allocations are aligned to this many bytes
+#define POOL_ALIGNMENT 16
+
+#define POOL_ALIGN_UP(n) (((n) + (POOL_ALIGNMENT - 1)) & ~(size_t)(POOL_ALIGNMENT - 1))
+
+// Bump allocator for buffers that live as long as their owner (receive
+// buffers, scratch space). Individual allocations are never freed; the whole
+// arena is reset or rolled back to a mark instead.
+typedef struct {
+    unsigned char* base;
+    size_t size;
+    size_t used;
+
+    size_t heap_allocs;                 // malloc calls made by this arena
+    size_t allocs;                      // Successful arena_alloc calls
+    size_t failures;                    // arena_alloc calls that did not fit
+    size_t peak_used;                   // High-water mark of used bytes
+} Arena;
+
+/**
+ * @brief Allocate the single backing block of an arena
+ * @return 1 on success, 0 if the block could not be allocated
+ */
+static inline int arena_init(Arena* a, size_t size) {
+    memset(a, 0, sizeof(*a));
+    if (size == 0) return 0;
+    a->base = (unsigned char*)malloc(size);
+    if (!a->base) return 0;
+    a->heap_allocs++;
+    a->size = size;
+    return 1;
+}
+
+/**
+ * @brief Release the backing block of an arena
+ */
+static inline void arena_destroy(Arena* a) {
+    free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
+
+/**
+ * @brief Carve an aligned block out of the arena
+ * @return Pointer to the block, or NULL if the arena is full
+ */
+static inline void* arena_alloc(Arena* a, size_t size) {
+    size_t offset = POOL_ALIGN_UP(a->used);
+    if (!a->base || offset > a->size || size > a->size - offset) {
+        a->failures++;
+        return NULL;
+    }
+    a->used = offset + size;
+    a->allocs++;
+    if (a->used > a->peak_used) a->peak_used = a->used;
+    return a->base + offset;
+}
+
+/**
+ * @brief Current fill level, to be passed back to arena_rollback()
+ */
+static inline size_t arena_mark(const Arena* a) {
+    return a->used;
+}
+
+/**
+ * @brief Free everything allocated after the given mark
+ */
+static inline void arena_rollback(Arena* a, size_t mark) {
+    if (mark < a->used) a->used = mark;
+}
+
+/**
+ * @brief Free everything in the arena
+ */
+static inline void arena_reset(Arena* a) {
+    a->used = 0;
+}
+
+#endif // MEMORY_POOL_H
@@ -0,0 +1,438 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "coppeliasim_client.h"
+#include "clock_util.h"
+
+#ifndef _WIN32
+    #include <errno.h>
+    #include <poll.h>
+    #include <sched.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+#endif
+
+/*
+ * Live controller and transport metrics on a local Unix socket.
+ *
+ * The control thread updates a ControlMetrics block once per tick with plain
+ * stores (metrics_record_tick()). A MetricsServer thread running at idle
+ * priority answers every connection on the socket with a snapshot of it and
+ * of the client's ClientStats:
+ *
+ *   curl --unix-socket /tmp/cb.sock http://robot/metrics        Prometheus text
+ *   curl --unix-socket /tmp/cb.sock http://robot/metrics.json   JSON
+ *   nc -U /tmp/cb.sock                                          Prometheus text
+ *   echo json | nc -U /tmp/cb.sock                              JSON
+ *
+ * Exposed: frames received, lines, parse errors and truncated lines, wheel
+ * commands issued, sent and coalesced, reconnects, arm actions, the current
+ * controller state, time spent in and entries into each state, the RMS line
+ * error, and a histogram of the measured control-loop period.
+ *
+ * The server reads the counters without locking, so a snapshot taken during
+ * a tick may mix values from two consecutive ticks.
+ */
+
+#define METRICS_MAX_STATES 16
+#define METRICS_PERIOD_BUCKETS 10
+#define METRICS_ERROR_WINDOW_S 1.0       // Time constant of the recent RMS line error
+#define METRICS_RESPONSE_SIZE 16384
+#define METRICS_REQUEST_WAIT_MS 50       // How long a connection may take to say what it wants
+#define METRICS_POLL_MS 200              // Accept timeout, so the server notices a stop
+
+// Upper bounds of the loop-period histogram buckets, seconds (+Inf is implied)
+static const double metrics_period_bounds[METRICS_PERIOD_BUCKETS] = {
+    0.005, 0.010, 0.020, 0.030, 0.050, 0.075, 0.100, 0.150, 0.250, 0.500};
+
+typedef struct {
+    const char* const* state_names;
+    int state_count;
+
+    // Written by the control thread
+    volatile int state;
+    double start_time;
+    double last_tick;                   // 0 before the first tick
+    unsigned long ticks;
+    double state_seconds[METRICS_MAX_STATES];
+    unsigned long state_entries[METRICS_MAX_STATES];
+    double error_squared_sum;           // Over every tick with the line in sight
+    unsigned long error_samples;
+    double error_recent_squared;        // Exponentially weighted over METRICS_ERROR_WINDOW_S
+    unsigned long period_buckets[METRICS_PERIOD_BUCKETS + 1];  // Not cumulative; the last one is +Inf
+    double period_sum;
+} ControlMetrics;
+
+/**
+ * @brief Starts a metrics block for a controller
+ * @param m Pointer to ControlMetrics structure
+ * @param state_names Names of the controller states, indexed by state value
+ * @param state_count Number of states (at most METRICS_MAX_STATES are tracked)
+ */
+static inline void metrics_init(ControlMetrics* m, const char* const* state_names, int state_count) {
+    memset(m, 0, sizeof(*m));
+    m->state_names = state_names;
+    m->state_count = state_count < METRICS_MAX_STATES ? state_count : METRICS_MAX_STATES;
+    m->state = -1;
+    m->start_time = monotonic_seconds();
+}
+
+/**
+ * @brief Records one control tick (control thread)
+ * @param m Pointer to ControlMetrics structure
+ * @param now Time of the tick, seconds (monotonic clock)
+ * @param state Controller state after the tick
+ * @param line_seen true if the line was in sight, so line_error counts
+ * @param line_error Line position error of the tick
+ *
+ * The time since the previous tick is the loop period. It is added to the
+ * histogram and to the time of the state the controller was in meanwhile.
+ */
+static inline void metrics_record_tick(ControlMetrics* m, double now, int state, bool line_seen, float line_error) {
+    if (m->last_tick > 0) {
+        double period = now - m->last_tick;
+        int b = 0;
+        while (b < METRICS_PERIOD_BUCKETS && period > metrics_period_bounds[b]) b++;
+        m->period_buckets[b]++;
+        m->period_sum += period;
+        if (m->state >= 0 && m->state < m->state_count) m->state_seconds[m->state] += period;
+
+        if (line_seen) {
+            double w = period / METRICS_ERROR_WINDOW_S;
+            if (w > 1) w = 1;
+            m->error_recent_squared += (line_error * line_error - m->error_recent_squared) * w;
+        }
+    }
+    if (line_seen) {
+        m->error_squared_sum += line_error * line_error;
+        m->error_samples++;
+    }
+    if (state != m->state && state >= 0 && state < m->state_count) m->state_entries[state]++;
+    m->state = state;
+    m->last_tick = now;
+    m->ticks++;
+}
+
+/**
+ * @brief Appends formatted text to a response buffer; output past the end is dropped
+ */
+static inline void metrics_append(char* buffer, size_t size, size_t* used, const char* format, ...) {
+    if (*used >= size) return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + *used, size - *used, format, args);
+    va_end(args);
+    if (n > 0) *used = (*used + (size_t)n < size) ? *used + (size_t)n : size;
+}
+
+/**
+ * @brief Writes the metrics in the Prometheus text exposition format
+ * @return Bytes written (the output is cut at size)
+ */
+static inline size_t metrics_render_prometheus(const ControlMetrics* m, const ClientStats* st, double now,
+                                               char* buffer, size_t size) {
+    size_t n = 0;
+    if (st) {
+        static const struct {
+            const char* name;
+            const char* help;
+            size_t offset;
+        } counters[] = {
+            {"cb_frames_received_total", "Sensor lines parsed and applied", offsetof(ClientStats, frames_received)},
+            {"cb_lines_received_total", "Complete lines received", offsetof(ClientStats, lines_received)},
+            {"cb_parse_errors_total", "Lines that were neither a sensor frame nor an acknowledgement",
+             offsetof(ClientStats, parse_errors)},
+            {"cb_lines_truncated_total", "Lines longer than the line buffer", offsetof(ClientStats, lines_truncated)},
+            {"cb_commands_sent_total", "Commands written to the link", offsetof(ClientStats, commands_sent)},
+            {"cb_motor_commands_total", "Wheel commands issued by the controller", offsetof(ClientStats, motor_commands)},
+            {"cb_motor_commands_coalesced_total", "Wheel commands skipped as repeats",
+             offsetof(ClientStats, motor_coalesced)},
+            {"cb_actions_sent_total", "PICK and DROP commands", offsetof(ClientStats, actions_sent)},
+            {"cb_actions_done_total", "Arm actions completed", offsetof(ClientStats, actions_done)},
+            {"cb_actions_failed_total", "Arm actions failed or timed out", offsetof(ClientStats, actions_failed)},
+        };
+        for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+            unsigned long v = *(const unsigned long*)(const void*)((const char*)st + counters[i].offset);
+            metrics_append(buffer, size, &n, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n", counters[i].name,
+                           counters[i].help, counters[i].name, counters[i].name, v);
+        }
+        metrics_append(buffer, size, &n, "# HELP cb_disconnects_total Connection losses\n"
+                                         "# TYPE cb_disconnects_total counter\ncb_disconnects_total %u\n",
+                       st->disconnects);
+        metrics_append(buffer, size, &n, "# HELP cb_reconnects_total Successful reconnects\n"
+                                         "# TYPE cb_reconnects_total counter\ncb_reconnects_total %u\n",
+                       st->reconnects);
+        metrics_append(buffer, size, &n, "# HELP cb_recovery_seconds_max Longest outage until data flowed again\n"
+                                         "# TYPE cb_recovery_seconds_max gauge\ncb_recovery_seconds_max %.6f\n",
+                       st->max_recovery_s);
+    }
+    if (!m) return n;
+
+    metrics_append(buffer, size, &n, "# HELP cb_uptime_seconds Time since the controller started\n"
+                                     "# TYPE cb_uptime_seconds gauge\ncb_uptime_seconds %.3f\n",
+                   now - m->start_time);
+    metrics_append(buffer, size, &n, "# HELP cb_ticks_total Control ticks\n# TYPE cb_ticks_total counter\n"
+                                     "cb_ticks_total %lu\n", m->ticks);
+
+    int state = m->state;
+    metrics_append(buffer, size, &n, "# HELP cb_state Current controller state (1 = active)\n# TYPE cb_state gauge\n");
+    for (int i = 0; i < m->state_count; i++) {
+        metrics_append(buffer, size, &n, "cb_state{state=\"%s\"} %d\n", m->state_names[i], i == state);
+    }
+    metrics_append(buffer, size, &n, "# HELP cb_state_seconds_total Time spent in each state\n"
+                                     "# TYPE cb_state_seconds_total counter\n");
+    for (int i = 0; i < m->state_count; i++) {
+        metrics_append(buffer, size, &n, "cb_state_seconds_total{state=\"%s\"} %.3f\n", m->state_names[i],
+                       m->state_seconds[i]);
+    }
+    metrics_append(buffer, size, &n, "# HELP cb_state_entries_total Transitions into each state\n"
+                                     "# TYPE cb_state_entries_total counter\n");
+    for (int i = 0; i < m->state_count; i++) {
+        metrics_append(buffer, size, &n, "cb_state_entries_total{state=\"%s\"} %lu\n", m->state_names[i],
+                       m->state_entries[i]);
+    }
+
+    metrics_append(buffer, size, &n, "# HELP cb_line_error_rms RMS line error over the last second\n"
+                                     "# TYPE cb_line_error_rms gauge\ncb_line_error_rms %.5f\n",
+                   sqrt(m->error_recent_squared));
+    metrics_append(buffer, size, &n, "# HELP cb_line_error_squared Sum of squared line errors, for RMS over any window\n"
+                                     "# TYPE cb_line_error_squared summary\n"
+                                     "cb_line_error_squared_sum %.6f\ncb_line_error_squared_count %lu\n",
+                   m->error_squared_sum, m->error_samples);
+
+    metrics_append(buffer, size, &n, "# HELP cb_loop_period_seconds Measured control-loop period\n"
+                                     "# TYPE cb_loop_period_seconds histogram\n");
+    unsigned long cumulative = 0;
+    for (int b = 0; b < METRICS_PERIOD_BUCKETS; b++) {
+        cumulative += m->period_buckets[b];
+        metrics_append(buffer, size, &n, "cb_loop_period_seconds_bucket{le=\"%g\"} %lu\n", metrics_period_bounds[b],
+                       cumulative);
+    }
+    cumulative += m->period_buckets[METRICS_PERIOD_BUCKETS];
+    metrics_append(buffer, size, &n, "cb_loop_period_seconds_bucket{le=\"+Inf\"} %lu\n"
+                                     "cb_loop_period_seconds_sum %.6f\ncb_loop_period_seconds_count %lu\n",
+                   cumulative, m->period_sum, cumulative);
+    return n;
+}
+
+/**
+ * @brief Writes the same metrics as one JSON object
+ * @return Bytes written (the output is cut at size)
+ */
+static inline size_t metrics_render_json(const ControlMetrics* m, const ClientStats* st, double now,
+                                         char* buffer, size_t size) {
+    size_t n = 0;
+    metrics_append(buffer, size, &n, "{");
+    if (st) {
+        metrics_append(buffer, size, &n,
+                       "\"client\": {\"frames_received\": %lu, \"lines_received\": %lu, \"parse_errors\": %lu, "
+                       "\"lines_truncated\": %lu, \"commands_sent\": %lu, \"motor_commands\": %lu, "
+                       "\"motor_coalesced\": %lu, \"disconnects\": %u, \"reconnects\": %u, "
+                       "\"max_recovery_s\": %.6f, \"actions_sent\": %lu, \"actions_done\": %lu, "
+                       "\"actions_failed\": %lu}%s",
+                       st->frames_received, st->lines_received, st->parse_errors, st->lines_truncated,
+                       st->commands_sent, st->motor_commands, st->motor_coalesced, st->disconnects, st->reconnects,
+                       st->max_recovery_s, st->actions_sent, st->actions_done, st->actions_failed, m ? ", " : "");
+    }
+    if (m) {
+        int state = m->state;
+        metrics_append(buffer, size, &n, "\"uptime_s\": %.3f, \"ticks\": %lu, \"state\": \"%s\", \"states\": {",
+                       now - m->start_time, m->ticks,
+                       state >= 0 && state < m->state_count ? m->state_names[state] : "");
+        for (int i = 0; i < m->state_count; i++) {
+            metrics_append(buffer, size, &n, "%s\"%s\": {\"seconds\": %.3f, \"entries\": %lu}", i ? ", " : "",
+                           m->state_names[i], m->state_seconds[i], m->state_entries[i]);
+        }
+        metrics_append(buffer, size, &n, "}, \"line_error_rms\": %.5f, \"line_error_rms_total\": %.5f, "
+                                         "\"loop_period\": {\"bounds_s\": [",
+                       sqrt(m->error_recent_squared),
+                       m->error_samples ? sqrt(m->error_squared_sum / m->error_samples) : 0.0);
+        for (int b = 0; b < METRICS_PERIOD_BUCKETS; b++) {
+            metrics_append(buffer, size, &n, "%s%g", b ? ", " : "", metrics_period_bounds[b]);
+        }
+        metrics_append(buffer, size, &n, "], \"counts\": [");
+        unsigned long count = 0;
+        for (int b = 0; b <= METRICS_PERIOD_BUCKETS; b++) {
+            metrics_append(buffer, size, &n, "%s%lu", b ? ", " : "", m->period_buckets[b]);
+            count += m->period_buckets[b];
+        }
+        metrics_append(buffer, size, &n, "], \"sum_s\": %.6f, \"count\": %lu}", m->period_sum, count);
+    }
+    metrics_append(buffer, size, &n, "}\n");
+    return n;
+}
+
+// ==================== Server ====================
+
+typedef struct {
+    const ControlMetrics* metrics;
+    const SocketClient* client;
+    char path[108];                     // sizeof(sockaddr_un.sun_path)
+    volatile bool running;
+    unsigned long scrapes;
+#ifndef _WIN32
+    int listen_fd;
+    pthread_t thread;
+#endif
+} MetricsServer;
+
+#ifndef _WIN32
+/**
+ * @brief Writes all of data to a socket; gives up on the first error
+ */
+static inline void metrics_write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+/**
+ * @brief Answers one connection: reads what it asks for (briefly) and sends a snapshot
+ */
+static inline void metrics_serve(MetricsServer* s, int fd) {
+    static char response[METRICS_RESPONSE_SIZE];  // Only the server thread uses it
+    char request[256];
+    size_t got = 0;
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    while (got < sizeof(request) - 1 && poll(&p, 1, METRICS_REQUEST_WAIT_MS) > 0) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) break;
+        got += (size_t)n;
+        request[got] = '\0';
+        if (strchr(request, '\n') && strncmp(request, "GET ", 4) != 0) break;  // Plain one-line request
+        if (strstr(request, "\r\n\r\n")) break;                                 // End of HTTP headers
+    }
+    request[got] = '\0';
+
+    // First request line only: "json", or an HTTP GET of a path ending in .json
+    char* eol = strchr(request, '\n');
+    if (eol) *eol = '\0';
+    bool http = strncmp(request, "GET ", 4) == 0;
+    bool json = strstr(request, "json") != NULL;
+
+    const ClientStats* stats = s->client ? client_stats(s->client) : NULL;
+    double now = monotonic_seconds();
+    size_t length = json ? metrics_render_json(s->metrics, stats, now, response, sizeof(response))
+                         : metrics_render_prometheus(s->metrics, stats, now, response, sizeof(response));
+    if (http) {
+        char header[160];
+        int n = snprintf(header, sizeof(header),
+                         "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                         json ? "application/json" : "text/plain; version=0.0.4", length);
+        metrics_write_all(fd, header, (size_t)n);
+    }
+    metrics_write_all(fd, response, length);
+    s->scrapes++;
+}
+
+static inline void* metrics_server_loop(void* arg) {
+    MetricsServer* s = (MetricsServer*)arg;
+#ifdef SCHED_IDLE
+    // Scrapes only run when nothing else wants the CPU
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    struct pollfd p;
+    p.fd = s->listen_fd;
+    p.events = POLLIN;
+    while (s->running) {
+        if (poll(&p, 1, METRICS_POLL_MS) <= 0) continue;
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        metrics_serve(s, fd);
+        close(fd);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Starts serving metrics on a Unix socket
+ * @param s Pointer to MetricsServer structure
+ * @param path Socket path; an existing socket file there is replaced
+ * @param metrics Controller metrics (NULL = client statistics only)
+ * @param client Client whose statistics are served (NULL = controller metrics only)
+ * @return 1 on success, 0 if the socket could not be set up
+ */
+static inline int metrics_server_start(MetricsServer* s, const char* path, const ControlMetrics* metrics,
+                                       const SocketClient* client) {
+    memset(s, 0, sizeof(*s));
+    s->metrics = metrics;
+    s->client = client;
+#ifdef _WIN32
+    (void)path;
+    printf("Metrics socket not supported on this platform\n");
+    return 0;
+#else
+    s->listen_fd = -1;
+    if (strlen(path) >= sizeof(s->path)) {
+        printf("Metrics socket path too long: %s\n", path);
+        return 0;
+    }
+    snprintf(s->path, sizeof(s->path), "%s", path);
+
+    // Replace a socket left over from a previous run, but never any other file
+    struct stat st;
+    if (lstat(s->path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            printf("Metrics socket %s: exists and is not a socket, not replacing it\n", s->path);
+            return 0;
+        }
+        unlink(s->path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, s->path, strlen(s->path) + 1);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        printf("Metrics socket %s: %s\n", s->path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+    s->listen_fd = fd;
+    s->running = true;
+    if (pthread_create(&s->thread, NULL, metrics_server_loop, s) != 0) {
+        s->running = false;
+        close(fd);
+        unlink(s->path);
+        s->listen_fd = -1;
+        return 0;
+    }
+    return 1;
+#endif
+}
+
+/**
+ * @brief Stops the server and removes its socket
+ */
+static inline void metrics_server_stop(MetricsServer* s) {
+#ifndef _WIN32
+    if (!s->running) return;
+    s->running = false;
+    pthread_join(s->thread, NULL);
+    close(s->listen_fd);
+    unlink(s->path);
+    s->listen_fd = -1;
+#else
+    (void)s;
+#endif
+}
+
+#endif // METRICS_H
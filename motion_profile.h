@@ -0,0 +1,144 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+/*
+ * Jerk-limited approach profile towards a box.
+ *
+ * Every tick the profile takes the (filtered) distance to the box and returns
+ * the forward wheel command. The target speed follows a braking curve that
+ * ends at stop_distance,
+ *
+ *   target = min(max_speed, sqrt(2 * decel * (distance - stop_distance)) / speed_gain)
+ *
+ * and the command moves towards it with the acceleration limited to
+ * accel/decel and the change of acceleration limited to jerk, so the robot
+ * ramps up, cruises and decelerates into the pick pose without steps. Near
+ * the pose the command never drops below min_speed, so friction cannot stall
+ * the robot just short of it. When the measured closing speed shows the
+ * robot moving faster than speed_gain predicts, the measured ratio is used
+ * instead, so an optimistic gain cannot make the robot brake too late.
+ *
+ * approach_profile_settled() replaces fixed settle waits: the robot is ready
+ * to pick once it is inside the pick window, commanded to (almost) zero and
+ * the sensors say it has stopped closing in, or once it has already passed
+ * the pose.
+ */
+
+#define APPROACH_MAX_ACCEL 1.5f          // Command units per second
+#define APPROACH_MAX_JERK 20.0f          // Command units per second^2
+#define APPROACH_DECEL 0.4f              // Braking deceleration, m/s^2
+#define APPROACH_MIN_SPEED 0.05f         // Creep speed outside the pick window, command units
+#define APPROACH_TOLERANCE 0.02f         // Half width of the pick window, m
+#define APPROACH_SETTLE_SPEED 0.02f      // Commanded speed that counts as stopped
+#define APPROACH_SETTLE_RATE 0.03f       // Measured closing speed that counts as stopped, m/s
+
+typedef struct {
+    // Limits
+    float max_speed;                    // Command units
+    float min_speed;
+    float accel;                        // Command units per second
+    float jerk;                         // Command units per second^2
+    float decel;                        // m/s^2 along the braking curve
+    float speed_gain;                   // m/s per command unit
+    float stop_distance;                // Pick pose, m
+    float tolerance;                    // Pick window is stop_distance +/- tolerance
+
+    // Current command
+    float speed;
+    float acceleration;
+} ApproachProfile;
+
+/**
+ * @brief Sets the limits of an approach profile
+ * @param p Pointer to ApproachProfile structure
+ * @param max_speed Cruise speed, command units
+ * @param stop_distance Distance to the box at the pick pose, m
+ * @param speed_gain m/s per command unit (e.g. StateEstimator.speed_gain)
+ */
+static inline void approach_profile_init(ApproachProfile* p, float max_speed, float stop_distance, float speed_gain) {
+    memset(p, 0, sizeof(*p));
+    p->max_speed = max_speed;
+    p->min_speed = APPROACH_MIN_SPEED;
+    p->accel = APPROACH_MAX_ACCEL;
+    p->jerk = APPROACH_MAX_JERK;
+    p->decel = APPROACH_DECEL;
+    p->speed_gain = speed_gain > 0 ? speed_gain : 1.0f;
+    p->stop_distance = stop_distance;
+    p->tolerance = APPROACH_TOLERANCE;
+}
+
+/**
+ * @brief Starts a new approach from the current forward speed
+ */
+static inline void approach_profile_start(ApproachProfile* p, float current_speed) {
+    p->speed = current_speed > 0 ? current_speed : 0;
+    p->acceleration = 0;
+}
+
+/**
+ * @brief Advances the profile by dt seconds
+ * @param p Pointer to ApproachProfile structure
+ * @param distance Current distance to the box, m
+ * @param closing_speed Measured closing speed, m/s
+ * @param dt Seconds since the previous step
+ * @return Forward wheel command
+ */
+static inline float approach_profile_step(ApproachProfile* p, float distance, float closing_speed, float dt) {
+    if (dt <= 0) return p->speed;
+
+    float gain = p->speed_gain;
+    if (p->speed > p->min_speed && closing_speed > p->speed * gain) gain = closing_speed / p->speed;
+
+    float remaining = distance - p->stop_distance;
+    float max_brake = p->decel / gain;
+    float target = 0;
+    if (remaining > p->tolerance) {
+        // Braking only reaches full deceleration after max_brake / jerk seconds;
+        // start the curve that much distance earlier
+        float ramp = p->speed * gain * (max_brake / p->jerk);
+        float braking = remaining - ramp;
+        target = braking > 0 ? sqrtf(2.0f * p->decel * braking) / gain : 0;
+        if (target > p->max_speed) target = p->max_speed;
+        if (target < p->min_speed) target = p->min_speed;
+    }
+
+    // Acceleration that would reach the target this tick, within the limits
+    float wanted = (target - p->speed) / dt;
+    if (wanted > p->accel) wanted = p->accel;
+    if (wanted < -max_brake) wanted = -max_brake;
+
+    // Jerk limit on the change of acceleration
+    float step = p->jerk * dt;
+    if (wanted > p->acceleration + step) wanted = p->acceleration + step;
+    else if (wanted < p->acceleration - step) wanted = p->acceleration - step;
+    p->acceleration = wanted;
+
+    p->speed += p->acceleration * dt;
+    if (p->speed < 0) {
+        p->speed = 0;
+        p->acceleration = 0;
+    }
+    if (p->speed > p->max_speed) {
+        p->speed = p->max_speed;
+        p->acceleration = 0;
+    }
+    return p->speed;
+}
+
+/**
+ * @brief True when the robot is ready to pick
+ * @param p Pointer to ApproachProfile structure
+ * @param distance Current distance to the box, m
+ * @param closing_speed Measured closing speed, m/s (e.g. from the state estimator)
+ */
+static inline bool approach_profile_settled(const ApproachProfile* p, float distance, float closing_speed) {
+    if (distance < p->stop_distance - p->tolerance) return true;   // Already past the pose
+    return distance <= p->stop_distance + p->tolerance && p->speed <= APPROACH_SETTLE_SPEED &&
+           fabsf(closing_speed) <= APPROACH_SETTLE_RATE;
+}
+
+#endif // MOTION_PROFILE_H
@@ -0,0 +1,516 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+/*
+ * Segmented, append-only recording of one stream (receive input or control
+ * output) with a seekable index.
+ *
+ * A recording with base name "run.in" consists of:
+ *
+ *   run.in.seg000000, run.in.seg000001, ...   segment files
+ *   run.in.idx                                index file
+ *
+ * Segment file: RecordingSegmentHeader (32 bytes), then records. Each record
+ * is a RecordingRecordHeader (24 bytes) followed by `length` payload bytes,
+ * padded to a multiple of 8. The CRC32 covers the header (after the crc
+ * field) and the payload, so a reader stops cleanly at a torn tail after a
+ * crash. A new segment is started once the current one exceeds the size limit.
+ *
+ * Index file: RecordingIndexHeader (16 bytes), then fixed-size
+ * RecordingIndexEntry items, each with its own CRC32. TIME entries are written
+ * at a fixed interval of recorded time; STATE entries at every controller
+ * state transition, numbered per state. Entries are in time order, so the
+ * reader can binary-search them or jump straight to "the Nth entry of state X"
+ * without touching the segments.
+ *
+ * All integers are in host byte order. Nothing is ever rewritten in place.
+ */
+
+#define RECORDING_SEGMENT_MAGIC "CBSEG01"
+#define RECORDING_INDEX_MAGIC "CBIDX01"
+#define RECORDING_VERSION 1
+#define RECORDING_PATH_LENGTH 256
+#define RECORDING_SEGMENT_LIMIT (64u * 1024u * 1024u)
+#define RECORDING_TIME_INTERVAL 1.0      // seconds of recorded time between TIME entries
+#define RECORDING_FLUSH_INTERVAL 0.5     // seconds between forced flushes to the OS
+#define RECORDING_MAX_STATES 32
+
+// Record types
+#define REC_SENSOR_LINE 1                // Raw sensor line from receive_loop (no newline)
+#define REC_COMMAND     2                // Text command sent to the server (with newline)
+#define REC_STATE       3                // int32 controller state after a transition
+
+// Index entry kinds
+#define INDEX_TIME  1
+#define INDEX_STATE 2
+
+typedef struct {
+    char magic[8];                      // RECORDING_SEGMENT_MAGIC
+    uint32_t version;
+    uint32_t segment_no;
+    double start_time;                  // Timestamp of the record that opened the segment (0 for the first)
+    uint64_t first_sequence;            // Sequence number of the first record
+} RecordingSegmentHeader;
+
+typedef struct {
+    uint32_t crc;                       // CRC32 of the rest of the header and the payload
+    uint16_t type;                      // REC_*
+    uint16_t length;                    // Payload bytes (without padding)
+    uint64_t sequence;                  // Record number since the recording started
+    double timestamp;                   // Seconds (monotonic clock)
+} RecordingRecordHeader;
+
+typedef struct {
+    char magic[8];                      // RECORDING_INDEX_MAGIC
+    uint32_t version;
+    uint32_t reserved;
+} RecordingIndexHeader;
+
+typedef struct {
+    uint32_t crc;                       // CRC32 of the rest of the entry
+    uint16_t kind;                      // INDEX_*
+    uint16_t reserved;
+    int32_t state;                      // New state (INDEX_STATE only)
+    uint32_t state_ordinal;             // 1 for the first entry into this state, 2 for the second, ...
+    double timestamp;
+    uint64_t sequence;                  // Sequence number of the referenced record
+    uint32_t segment_no;
+    uint32_t offset;                    // Byte offset of the record in its segment
+} RecordingIndexEntry;
+
+// Writer for one stream; must be used from a single thread
+typedef struct {
+    char base[RECORDING_PATH_LENGTH];
+    FILE* segment;
+    FILE* index;
+    uint32_t segment_no;
+    uint64_t segment_offset;            // Write position in the current segment
+    uint64_t sequence;                  // Next record sequence number
+    double next_time_entry;             // Timestamp at which the next TIME entry is due
+    double last_flush;
+    uint32_t state_counts[RECORDING_MAX_STATES];
+
+    uint64_t bytes_written;
+    uint64_t write_errors;
+} Recorder;
+
+// One decoded record; payload points into the mapped segment
+typedef struct {
+    uint16_t type;
+    uint16_t length;
+    uint64_t sequence;
+    double timestamp;
+    const unsigned char* payload;
+} RecordingRecord;
+
+// Read-only view of a whole file (mmap on POSIX, heap copy on Windows)
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+} MappedFile;
+
+typedef struct {
+    char base[RECORDING_PATH_LENGTH];
+    MappedFile index;
+    const RecordingIndexEntry* entries; // Valid (checksummed) index entries
+    size_t entry_count;
+
+    MappedFile segment;                 // Currently mapped segment
+    uint32_t segment_no;
+    size_t position;                    // Read position in the mapped segment
+    int segment_open;
+} RecordingReader;
+
+/**
+ * @brief CRC32 (IEEE 802.3), continuing from a previous value
+ */
+static inline uint32_t recording_crc32(uint32_t crc, const void* data, size_t len) {
+    // Nibble table: small enough to be a constant, so it is safe from any thread
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    const unsigned char* p = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = table[crc & 0xF] ^ (crc >> 4);
+        crc = table[crc & 0xF] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static inline void recording_segment_path(char* out, size_t size, const char* base, uint32_t segment_no) {
+    snprintf(out, size, "%s.seg%06u", base, (unsigned)segment_no);
+}
+
+static inline void recording_index_path(char* out, size_t size, const char* base) {
+    snprintf(out, size, "%s.idx", base);
+}
+
+static inline int recorder_start_segment(Recorder* r, double timestamp) {
+    char path[RECORDING_PATH_LENGTH + 16];
+    recording_segment_path(path, sizeof(path), r->base, r->segment_no);
+    r->segment = fopen(path, "wb");
+    if (!r->segment) return 0;
+
+    RecordingSegmentHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RECORDING_SEGMENT_MAGIC, sizeof(RECORDING_SEGMENT_MAGIC));
+    hdr.version = RECORDING_VERSION;
+    hdr.segment_no = r->segment_no;
+    hdr.start_time = timestamp;
+    hdr.first_sequence = r->sequence;
+    if (fwrite(&hdr, sizeof(hdr), 1, r->segment) != 1) return 0;
+
+    r->segment_offset = sizeof(hdr);
+    r->bytes_written += sizeof(hdr);
+    return 1;
+}
+
+static inline void recorder_write_index(Recorder* r, RecordingIndexEntry* e) {
+    e->crc = recording_crc32(0, (const unsigned char*)e + sizeof(e->crc), sizeof(*e) - sizeof(e->crc));
+    if (fwrite(e, sizeof(*e), 1, r->index) != 1) r->write_errors++;
+    else r->bytes_written += sizeof(*e);
+}
+
+/**
+ * @brief Creates the first segment and the index file of a recording
+ * @param r Pointer to Recorder structure
+ * @param base Base path; ".segNNNNNN" and ".idx" are appended
+ * @return 1 on success, 0 if a file could not be created
+ */
+static inline int recorder_open(Recorder* r, const char* base) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->base, sizeof(r->base), "%s", base);
+
+    char path[RECORDING_PATH_LENGTH + 16];
+    recording_index_path(path, sizeof(path), r->base);
+    r->index = fopen(path, "wb");
+    if (!r->index) return 0;
+
+    RecordingIndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RECORDING_INDEX_MAGIC, sizeof(RECORDING_INDEX_MAGIC));
+    hdr.version = RECORDING_VERSION;
+    if (fwrite(&hdr, sizeof(hdr), 1, r->index) != 1 || !recorder_start_segment(r, 0.0)) {
+        if (r->segment) fclose(r->segment);
+        fclose(r->index);
+        r->segment = NULL;
+        r->index = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Flushes buffered records and index entries to the OS
+ */
+static inline void recorder_flush(Recorder* r) {
+    if (r->segment) fflush(r->segment);
+    if (r->index) fflush(r->index);
+}
+
+/**
+ * @brief Appends one record to the current segment
+ * @return Byte offset of the record in its segment, or 0 on failure
+ */
+static inline uint32_t recorder_append(Recorder* r, uint16_t type, double timestamp, const void* payload, size_t length) {
+    static const unsigned char padding[8] = {0};
+    if (!r->segment || length > 0xFFFF) return 0;
+
+    // Roll over before the segment grows past its limit
+    if (r->segment_offset >= RECORDING_SEGMENT_LIMIT) {
+        fclose(r->segment);
+        r->segment = NULL;
+        r->segment_no++;
+        if (!recorder_start_segment(r, timestamp)) {
+            r->write_errors++;
+            return 0;
+        }
+    }
+
+    RecordingRecordHeader hdr;
+    hdr.type = type;
+    hdr.length = (uint16_t)length;
+    hdr.sequence = r->sequence;
+    hdr.timestamp = timestamp;
+    hdr.crc = recording_crc32(0, (const unsigned char*)&hdr + sizeof(hdr.crc), sizeof(hdr) - sizeof(hdr.crc));
+    hdr.crc = recording_crc32(hdr.crc, payload, length);
+
+    size_t pad = (8 - (length & 7)) & 7;
+    if (fwrite(&hdr, sizeof(hdr), 1, r->segment) != 1 ||
+        (length && fwrite(payload, 1, length, r->segment) != length) ||
+        (pad && fwrite(padding, 1, pad, r->segment) != pad)) {
+        r->write_errors++;
+        return 0;
+    }
+
+    uint32_t offset = (uint32_t)r->segment_offset;
+    size_t total = sizeof(hdr) + length + pad;
+    r->segment_offset += total;
+    r->bytes_written += total;
+
+    // Periodic time checkpoint pointing at this record
+    if (timestamp >= r->next_time_entry) {
+        RecordingIndexEntry e;
+        memset(&e, 0, sizeof(e));
+        e.kind = INDEX_TIME;
+        e.timestamp = timestamp;
+        e.sequence = r->sequence;
+        e.segment_no = r->segment_no;
+        e.offset = offset;
+        recorder_write_index(r, &e);
+        r->next_time_entry = timestamp + RECORDING_TIME_INTERVAL;
+    }
+    r->sequence++;
+
+    // Bound what a crash can lose without flushing on every record
+    if (timestamp - r->last_flush >= RECORDING_FLUSH_INTERVAL) {
+        recorder_flush(r);
+        r->last_flush = timestamp;
+    }
+    return offset;
+}
+
+/**
+ * @brief Records a controller state transition and indexes it
+ */
+static inline void recorder_mark_state(Recorder* r, double timestamp, int32_t state) {
+    if (!r->segment) return;
+
+    uint32_t offset = recorder_append(r, REC_STATE, timestamp, &state, sizeof(state));
+    if (offset == 0) return;
+
+    RecordingIndexEntry e;
+    memset(&e, 0, sizeof(e));
+    e.kind = INDEX_STATE;
+    e.state = state;
+    if (state >= 0 && state < RECORDING_MAX_STATES) e.state_ordinal = ++r->state_counts[state];
+    e.timestamp = timestamp;
+    e.sequence = r->sequence - 1;
+    e.segment_no = r->segment_no;       // The record went into the current segment
+    e.offset = offset;
+    recorder_write_index(r, &e);
+}
+
+/**
+ * @brief Flushes and closes all files of a recording
+ */
+static inline void recorder_close(Recorder* r) {
+    if (r->segment) fclose(r->segment);
+    if (r->index) fclose(r->index);
+    r->segment = NULL;
+    r->index = NULL;
+}
+
+/**
+ * @brief Maps a whole file read-only
+ * @return 1 on success, 0 if the file is missing or empty
+ */
+static inline int map_file(MappedFile* m, const char* path) {
+    m->data = NULL;
+    m->size = 0;
+#ifdef _WIN32
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return 0;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char* buf = size > 0 ? (unsigned char*)malloc((size_t)size) : NULL;
+    if (!buf || fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+        free(buf);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    m->data = buf;
+    m->size = (size_t)size;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return 0;
+    m->data = (const unsigned char*)p;
+    m->size = (size_t)st.st_size;
+#endif
+    return 1;
+}
+
+static inline void unmap_file(MappedFile* m) {
+    if (!m->data) return;
+#ifdef _WIN32
+    free((void*)m->data);
+#else
+    munmap((void*)m->data, m->size);
+#endif
+    m->data = NULL;
+    m->size = 0;
+}
+
+/**
+ * @brief Opens a recording and validates its index
+ * @param rd Pointer to RecordingReader structure
+ * @param base Base path used when recording
+ * @return 1 on success, 0 if the index is missing or malformed
+ *
+ * Index entries are accepted up to the first one whose checksum fails, so an
+ * index torn by a crash is still usable.
+ */
+static inline int recording_reader_open(RecordingReader* rd, const char* base) {
+    memset(rd, 0, sizeof(*rd));
+    snprintf(rd->base, sizeof(rd->base), "%s", base);
+
+    char path[RECORDING_PATH_LENGTH + 16];
+    recording_index_path(path, sizeof(path), rd->base);
+    if (!map_file(&rd->index, path)) return 0;
+
+    const RecordingIndexHeader* hdr = (const RecordingIndexHeader*)rd->index.data;
+    if (rd->index.size < sizeof(*hdr) || memcmp(hdr->magic, RECORDING_INDEX_MAGIC, sizeof(RECORDING_INDEX_MAGIC)) != 0) {
+        unmap_file(&rd->index);
+        return 0;
+    }
+
+    rd->entries = (const RecordingIndexEntry*)(rd->index.data + sizeof(*hdr));
+    size_t n = (rd->index.size - sizeof(*hdr)) / sizeof(RecordingIndexEntry);
+    for (rd->entry_count = 0; rd->entry_count < n; rd->entry_count++) {
+        const RecordingIndexEntry* e = &rd->entries[rd->entry_count];
+        uint32_t crc = recording_crc32(0, (const unsigned char*)e + sizeof(e->crc), sizeof(*e) - sizeof(e->crc));
+        if (crc != e->crc) break;
+    }
+    return 1;
+}
+
+/**
+ * @brief Unmaps all files of a recording
+ */
+static inline void recording_reader_close(RecordingReader* rd) {
+    unmap_file(&rd->segment);
+    unmap_file(&rd->index);
+    rd->entries = NULL;
+    rd->entry_count = 0;
+    rd->segment_open = 0;
+}
+
+/**
+ * @brief Finds the Nth entry into a controller state
+ * @param state State value passed to recorder_mark_state
+ * @param nth 1-based occurrence
+ * @return Index entry, or NULL if the state was entered fewer than nth times
+ */
+static inline const RecordingIndexEntry* recording_find_state(const RecordingReader* rd, int32_t state, uint32_t nth) {
+    for (size_t i = 0; i < rd->entry_count; i++) {
+        const RecordingIndexEntry* e = &rd->entries[i];
+        if (e->kind == INDEX_STATE && e->state == state && e->state_ordinal == nth) return e;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Finds the last index entry at or before a timestamp
+ * @return Index entry, or NULL if the timestamp precedes the recording
+ */
+static inline const RecordingIndexEntry* recording_find_time(const RecordingReader* rd, double timestamp) {
+    size_t lo = 0, hi = rd->entry_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rd->entries[mid].timestamp <= timestamp) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? &rd->entries[lo - 1] : NULL;
+}
+
+static inline int recording_map_segment(RecordingReader* rd, uint32_t segment_no) {
+    if (rd->segment_open && rd->segment_no == segment_no) return 1;
+
+    unmap_file(&rd->segment);
+    rd->segment_open = 0;
+
+    char path[RECORDING_PATH_LENGTH + 16];
+    recording_segment_path(path, sizeof(path), rd->base, segment_no);
+    if (!map_file(&rd->segment, path)) return 0;
+
+    const RecordingSegmentHeader* hdr = (const RecordingSegmentHeader*)rd->segment.data;
+    if (rd->segment.size < sizeof(*hdr) || memcmp(hdr->magic, RECORDING_SEGMENT_MAGIC, sizeof(RECORDING_SEGMENT_MAGIC)) != 0) {
+        unmap_file(&rd->segment);
+        return 0;
+    }
+
+    rd->segment_no = segment_no;
+    rd->position = sizeof(*hdr);
+    rd->segment_open = 1;
+    return 1;
+}
+
+/**
+ * @brief Positions the reader at the record an index entry points to
+ * @return 1 on success, 0 if the segment cannot be opened
+ */
+static inline int recording_seek(RecordingReader* rd, const RecordingIndexEntry* e) {
+    if (!e || !recording_map_segment(rd, e->segment_no)) return 0;
+    if (e->offset < sizeof(RecordingSegmentHeader) || e->offset >= rd->segment.size) return 0;
+    rd->position = e->offset;
+    return 1;
+}
+
+/**
+ * @brief Positions the reader at the first record of the recording
+ */
+static inline int recording_rewind(RecordingReader* rd) {
+    rd->segment_open = 0;
+    return recording_map_segment(rd, 0);
+}
+
+/**
+ * @brief Reads the record at the current position and advances past it
+ * @param rd Pointer to RecordingReader structure
+ * @param rec Decoded record (payload stays valid until the segment changes)
+ * @return 1 if a record was read, 0 at the end of the recording or at the
+ *         first record whose checksum fails
+ */
+static inline int recording_next(RecordingReader* rd, RecordingRecord* rec) {
+    if (!rd->segment_open) return 0;
+
+    // Continue into the next segment once this one is exhausted
+    if (rd->position + sizeof(RecordingRecordHeader) > rd->segment.size) {
+        if (!recording_map_segment(rd, rd->segment_no + 1)) return 0;
+    }
+
+    const RecordingRecordHeader* hdr = (const RecordingRecordHeader*)(rd->segment.data + rd->position);
+    size_t payload_at = rd->position + sizeof(*hdr);
+    if (rd->position + sizeof(*hdr) > rd->segment.size || payload_at + hdr->length > rd->segment.size) return 0;
+
+    uint32_t crc = recording_crc32(0, (const unsigned char*)hdr + sizeof(hdr->crc), sizeof(*hdr) - sizeof(hdr->crc));
+    crc = recording_crc32(crc, rd->segment.data + payload_at, hdr->length);
+    if (crc != hdr->crc) return 0;
+
+    rec->type = hdr->type;
+    rec->length = hdr->length;
+    rec->sequence = hdr->sequence;
+    rec->timestamp = hdr->timestamp;
+    rec->payload = rd->segment.data + payload_at;
+
+    rd->position = payload_at + hdr->length + ((8 - (hdr->length & 7)) & 7);
+    return 1;
+}
+
+#endif // RECORDING_H
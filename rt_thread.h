@@ -0,0 +1,345 @@
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock_util.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <errno.h>
+    #include <poll.h>
+    #include <time.h>
+    #include <unistd.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/mman.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+/*
+ * Optional real-time setup for the receive and control threads, plus an
+ * absolute-deadline cycle timer that measures wake-up latency the way
+ * cyclictest does.
+ *
+ * Every setting defaults to "leave the thread alone". Each thread reads its
+ * settings from the environment with its own prefix, e.g. for "CONTROL":
+ *
+ *   CB_RT_CONTROL_CPU=2            pin to CPU 2
+ *   CB_RT_CONTROL_POLICY=fifo      fifo, deadline or other
+ *   CB_RT_CONTROL_PRIORITY=80      SCHED_FIFO priority (1-99)
+ *   CB_RT_CONTROL_RUNTIME_US=2000  SCHED_DEADLINE runtime per period
+ *   CB_RT_CONTROL_PERIOD_US=50000  SCHED_DEADLINE period (= deadline)
+ *   CB_RT_CONTROL_PREFAULT=1       touch RT_PREFAULT_STACK_BYTES of stack
+ *   CB_RT_MLOCK=1                  mlockall() for the whole process
+ *
+ * FIFO and DEADLINE need CAP_SYS_NICE (or root). A setting that cannot be
+ * applied is reported and skipped; the thread keeps running either way.
+ */
+
+#define RT_PREFAULT_STACK_BYTES (256 * 1024)
+#define RT_HISTOGRAM_BUCKETS 1000        // 10 us buckets: 0 .. 10 ms
+#define RT_HISTOGRAM_BUCKET_US 10
+
+typedef enum {
+    RT_POLICY_OTHER,                    // Default time-sharing scheduler
+    RT_POLICY_FIFO,
+    RT_POLICY_DEADLINE                  // Linux only
+} RtPolicy;
+
+typedef struct {
+    int cpu;                            // CPU to pin to, -1 = any
+    RtPolicy policy;
+    int priority;                       // SCHED_FIFO priority
+    uint64_t runtime_us;                // SCHED_DEADLINE budget per period
+    uint64_t period_us;                 // SCHED_DEADLINE period and deadline
+    bool prefault_stack;
+} RtThreadConfig;
+
+// Absolute-deadline periodic wake-up with latency statistics
+typedef struct {
+    double next_wake;                   // Monotonic seconds of the next planned wake-up
+    uint64_t cycles;
+    uint64_t overruns;                  // Cycles that started after their next deadline had passed
+    double min_latency;                 // Actual minus planned wake-up time, seconds
+    double max_latency;
+    double total_latency;
+    uint32_t histogram[RT_HISTOGRAM_BUCKETS + 1];  // Last bucket counts everything above the range
+    int wake_fd;                        // Readable = stop waiting (e.g. lifecycle_fd()), -1 for none
+} RtCycleTimer;
+
+/**
+ * @brief Leaves a thread with default attributes
+ */
+static inline void rt_thread_config_init(RtThreadConfig* cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->cpu = -1;
+    cfg->policy = RT_POLICY_OTHER;
+}
+
+static inline const char* rt_env(char* name, size_t size, const char* prefix, const char* key) {
+    snprintf(name, size, "CB_RT_%s_%s", prefix, key);
+    return getenv(name);
+}
+
+/**
+ * @brief Reads CB_RT_<prefix>_* settings (see above); unset values keep the defaults
+ */
+static inline void rt_thread_config_from_env(RtThreadConfig* cfg, const char* prefix) {
+    char name[64];
+    const char* v;
+
+    rt_thread_config_init(cfg);
+    if ((v = rt_env(name, sizeof(name), prefix, "CPU")) != NULL) cfg->cpu = atoi(v);
+    if ((v = rt_env(name, sizeof(name), prefix, "POLICY")) != NULL) {
+        if (strcmp(v, "fifo") == 0) cfg->policy = RT_POLICY_FIFO;
+        else if (strcmp(v, "deadline") == 0) cfg->policy = RT_POLICY_DEADLINE;
+    }
+    if ((v = rt_env(name, sizeof(name), prefix, "PRIORITY")) != NULL) cfg->priority = atoi(v);
+    if ((v = rt_env(name, sizeof(name), prefix, "RUNTIME_US")) != NULL) cfg->runtime_us = strtoull(v, NULL, 10);
+    if ((v = rt_env(name, sizeof(name), prefix, "PERIOD_US")) != NULL) cfg->period_us = strtoull(v, NULL, 10);
+    if ((v = rt_env(name, sizeof(name), prefix, "PREFAULT")) != NULL) cfg->prefault_stack = atoi(v) != 0;
+}
+
+/**
+ * @brief Locks all current and future pages of the process into RAM
+ * @return 1 on success, 0 if not permitted or not supported
+ */
+static inline int rt_lock_memory(void) {
+#ifdef _WIN32
+    printf("RT: memory locking is not supported on Windows\n");
+    return 0;
+#else
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        printf("RT: mlockall failed: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+#endif
+}
+
+/**
+ * @brief Applies CB_RT_MLOCK from the environment
+ */
+static inline void rt_lock_memory_from_env(void) {
+    const char* v = getenv("CB_RT_MLOCK");
+    if (v && atoi(v) != 0) rt_lock_memory();
+}
+
+static inline void rt_prefault_stack(void) {
+    // Commit the stack pages the thread will use before it starts its cycle.
+    // The volatile stores keep the loop even when this is inlined.
+    volatile unsigned char stack[RT_PREFAULT_STACK_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+#ifdef __linux__
+// Kernel ABI for sched_setattr(2); glibc has no wrapper
+typedef struct {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;             // Nanoseconds
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+} RtSchedAttr;
+
+#define RT_SCHED_DEADLINE 6
+#endif
+
+/**
+ * @brief Applies a configuration to the calling thread
+ * @param cfg Settings (NULL = nothing to do)
+ * @param name Thread name used in messages
+ * @return 1 if every requested setting was applied, 0 otherwise
+ */
+static inline int rt_thread_apply(const RtThreadConfig* cfg, const char* name) {
+    if (!cfg) return 1;
+    int ok = 1;
+
+    if (cfg->cpu >= 0) {
+#ifdef _WIN32
+        if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cfg->cpu) == 0) ok = 0;
+#elif defined(__linux__)
+        unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+        memset(mask, 0, sizeof(mask));
+        if (cfg->cpu < 1024) mask[cfg->cpu / (8 * sizeof(unsigned long))] = 1UL << (cfg->cpu % (8 * sizeof(unsigned long)));
+        if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0) ok = 0;
+#else
+        ok = 0;
+#endif
+        if (!ok) printf("RT: could not pin %s thread to CPU %d\n", name, cfg->cpu);
+    }
+
+    if (cfg->policy == RT_POLICY_FIFO) {
+#ifdef _WIN32
+        if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+            printf("RT: could not raise %s thread priority\n", name);
+            ok = 0;
+        }
+#else
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = cfg->priority > 0 ? cfg->priority : 1;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            printf("RT: SCHED_FIFO for %s thread failed: %s\n", name, strerror(err));
+            ok = 0;
+        }
+#endif
+    } else if (cfg->policy == RT_POLICY_DEADLINE) {
+#ifdef __linux__
+        RtSchedAttr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.sched_policy = RT_SCHED_DEADLINE;
+        attr.sched_runtime = cfg->runtime_us * 1000;
+        attr.sched_deadline = cfg->period_us * 1000;
+        attr.sched_period = cfg->period_us * 1000;
+        if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0) {
+            printf("RT: SCHED_DEADLINE for %s thread failed: %s\n", name, strerror(errno));
+            ok = 0;
+        }
+#else
+        printf("RT: SCHED_DEADLINE is only available on Linux\n");
+        ok = 0;
+#endif
+    }
+
+    if (cfg->prefault_stack) rt_prefault_stack();
+    return ok;
+}
+
+/**
+ * @brief Starts the cycle timer at the current time
+ */
+static inline void rt_cycle_start(RtCycleTimer* t) {
+    memset(t, 0, sizeof(*t));
+    t->next_wake = monotonic_seconds();
+    t->min_latency = 1e9;
+    t->wake_fd = -1;
+}
+
+/**
+ * @brief Sleeps until an absolute monotonic time
+ */
+static inline void rt_sleep_until(double wake) {
+#ifdef _WIN32
+    double remaining = wake - monotonic_seconds();
+    if (remaining > 0) Sleep((DWORD)(remaining * 1000.0));
+    while (monotonic_seconds() < wake) {
+        // Spin the last sub-millisecond part
+    }
+#elif defined(__APPLE__)
+    double remaining = wake - monotonic_seconds();
+    if (remaining > 0) usleep((useconds_t)(remaining * 1e6));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)wake;
+    ts.tv_nsec = (long)((wake - (double)ts.tv_sec) * 1e9);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+#endif
+}
+
+/**
+ * @brief Sleeps until an absolute monotonic time, or until fd becomes readable
+ * @param wake Monotonic seconds to wake at
+ * @param fd Descriptor that cuts the sleep short, -1 for none
+ * @return true if fd became readable first
+ *
+ * poll() covers all but the last millisecond, which is slept on the absolute
+ * deadline, so the wake-up stays as precise as rt_sleep_until().
+ */
+static inline bool rt_sleep_until_fd(double wake, int fd) {
+#ifndef _WIN32
+    if (fd >= 0) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        for (;;) {
+            int ms = (int)((wake - monotonic_seconds()) * 1000.0) - 1;
+            if (ms <= 0) break;
+            int n = poll(&pfd, 1, ms);
+            if (n > 0) return true;
+            if (n < 0 && errno != EINTR) break;
+        }
+    }
+#else
+    (void)fd;
+#endif
+    rt_sleep_until(wake);
+    return false;
+}
+
+/**
+ * @brief Sleeps until the start of the next cycle and records the wake-up latency
+ * @param t Pointer to RtCycleTimer structure
+ * @param period_ms Length of the cycle that just ran
+ *
+ * Deadlines are absolute, so time spent in the cycle body does not add up as
+ * drift. If the body overran the whole period the schedule restarts from now.
+ * A readable wake_fd ends the wait at once; that cycle is not counted.
+ */
+static inline void rt_cycle_wait(RtCycleTimer* t, int period_ms) {
+    t->next_wake += period_ms / 1000.0;
+    double now = monotonic_seconds();
+    if (now > t->next_wake) {
+        t->overruns++;
+        t->next_wake = now;
+        return;
+    }
+
+    if (rt_sleep_until_fd(t->next_wake, t->wake_fd)) return;
+
+    double latency = monotonic_seconds() - t->next_wake;
+    if (latency < 0) latency = 0;
+    t->cycles++;
+    t->total_latency += latency;
+    if (latency < t->min_latency) t->min_latency = latency;
+    if (latency > t->max_latency) t->max_latency = latency;
+
+    size_t bucket = (size_t)(latency * 1e6 / RT_HISTOGRAM_BUCKET_US);
+    t->histogram[bucket < RT_HISTOGRAM_BUCKETS ? bucket : RT_HISTOGRAM_BUCKETS]++;
+}
+
+/**
+ * @brief Wake-up latency below which the given fraction of cycles fall
+ * @return Seconds (upper edge of the histogram bucket)
+ */
+static inline double rt_cycle_percentile(const RtCycleTimer* t, double fraction) {
+    uint64_t target = (uint64_t)(t->cycles * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i <= RT_HISTOGRAM_BUCKETS; i++) {
+        seen += t->histogram[i];
+        if (seen > target) return (i + 1) * RT_HISTOGRAM_BUCKET_US / 1e6;
+    }
+    return t->max_latency;
+}
+
+/**
+ * @brief Prints min/avg/p99/max wake-up latency and overruns, cyclictest style
+ */
+static inline void rt_cycle_report(const RtCycleTimer* t, const char* name) {
+    if (t->cycles == 0) {
+        printf("%s: no cycles measured (%llu overruns)\n", name, (unsigned long long)t->overruns);
+        return;
+    }
+    printf("%s: %llu cycles, wake latency min %.0f us, avg %.0f us, p99 %.0f us, max %.0f us, %llu overruns\n",
+           name, (unsigned long long)t->cycles, t->min_latency * 1e6, t->total_latency / t->cycles * 1e6,
+           rt_cycle_percentile(t, 0.99) * 1e6, t->max_latency * 1e6, (unsigned long long)t->overruns);
+}
+
+#endif // RT_THREAD_H
@@ -0,0 +1,514 @@
+#ifndef SENSOR_KERNELS_H
+#define SENSOR_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Sensor math shared by the controllers, in two forms:
+ *
+ *  - scalar kernels for one robot (used directly by Task2a.c / botoverturns.c)
+ *  - batch kernels over struct-of-arrays inputs for many robots or many
+ *    replayed frames, vectorised with SSE2/AVX2 and selected at runtime
+ *
+ * The vector paths evaluate exactly the same operations in the same order as
+ * the scalar kernels, so their outputs are bit-identical. This relies on the
+ * compiler not contracting a*b+c into FMA in the scalar code
+ * (-ffp-contract=off, or a target without FMA).
+ */
+
+// Color detection thresholds
+#define RED_THRESHOLD_R    0.7
+#define RED_THRESHOLD_G    0.3
+#define RED_THRESHOLD_B    0.3
+#define GREEN_THRESHOLD_R  0.3
+#define GREEN_THRESHOLD_G  0.7
+#define GREEN_THRESHOLD_B  0.3
+#define BLUE_THRESHOLD_R   0.3
+#define BLUE_THRESHOLD_G   0.3
+#define BLUE_THRESHOLD_B   0.7
+
+// Line sensor thresholds (lower values mean the line is under the sensor)
+#define LINE_SEEN_THRESHOLD  0.4
+#define LINE_CLEAR_THRESHOLD 0.6
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define SENSOR_KERNELS_X86 1
+    #include <immintrin.h>
+    #define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define SENSOR_KERNELS_X86 0
+#endif
+
+// Result of the line-following decision in follow_line()
+typedef enum {
+    LINE_STRAIGHT,       // Line under the center sensor
+    LINE_LEFT,           // Line on the left side only
+    LINE_RIGHT,          // Line on the right side only
+    LINE_INTERSECTION,   // Line on both sides
+    LINE_LOST            // No line detected
+} LineClass;
+
+typedef enum {
+    KERNEL_SCALAR,
+    KERNEL_SSE2,
+    KERNEL_AVX2
+} KernelLevel;
+
+typedef struct {
+    float Kp, Ki, Kd;
+} PidGains;
+
+typedef struct {
+    float integral;
+    float prev_error;
+} PidState;
+
+// Sensor readings of `count` robots (or frames), one array per channel
+typedef struct {
+    size_t count;
+    const float* ir[5];                 // left_corner, left, middle, right, right_corner
+    const float* color_r;
+    const float* color_g;
+    const float* color_b;
+} SensorBatch;
+
+// ==================== Scalar kernels ====================
+
+/**
+ * @brief Weighted centroid of the line under the five IR sensors
+ * @return Line position error in [-2, 2], 0 if no sensor sees the line
+ */
+static inline float line_centroid_error(const float ir[5]) {
+    const float w[5] = {-2, -1, 0, 1, 2};
+    float ws = 0, sum = 0;
+    for (int i = 0; i < 5; i++) {
+        float v = 1 - ir[i];
+        ws += w[i] * v;
+        sum += v;
+    }
+    return sum > 0 ? ws / sum : 0;
+}
+
+/**
+ * @brief One PID update
+ * @return Correction to add to the left wheel and subtract from the right
+ */
+static inline float pid_step(PidState* s, const PidGains* g, float error) {
+    s->integral += error;
+    float derivative = error - s->prev_error;
+    float corr = g->Kp * error + g->Ki * s->integral + g->Kd * derivative;
+    s->prev_error = error;
+    return corr;
+}
+
+/**
+ * @brief Line-following decision from the five IR sensors
+ */
+static inline LineClass classify_line(const float ir[5]) {
+    float left_error = (ir[0] + ir[1]) / 2.0;   // Average of left sensors
+    float right_error = (ir[3] + ir[4]) / 2.0;  // Average of right sensors
+    float center_error = ir[2];                 // Center sensor
+
+    if (center_error < LINE_SEEN_THRESHOLD) return LINE_STRAIGHT;
+    if (left_error < LINE_SEEN_THRESHOLD && right_error > LINE_CLEAR_THRESHOLD) return LINE_LEFT;
+    if (right_error < LINE_SEEN_THRESHOLD && left_error > LINE_CLEAR_THRESHOLD) return LINE_RIGHT;
+    if (left_error < LINE_SEEN_THRESHOLD && right_error < LINE_SEEN_THRESHOLD) return LINE_INTERSECTION;
+    return LINE_LOST;
+}
+
+/**
+ * @brief True when all five sensors see the line (Node N1 intersection)
+ */
+static inline int is_node_pattern(const float ir[5]) {
+    return ir[0] < LINE_SEEN_THRESHOLD && ir[1] < LINE_SEEN_THRESHOLD && ir[2] < LINE_SEEN_THRESHOLD &&
+           ir[3] < LINE_SEEN_THRESHOLD && ir[4] < LINE_SEEN_THRESHOLD;
+}
+
+/**
+ * @brief Threshold-based RGB classification
+ * @return 'R' for red, 'G' for green, 'B' for blue, 'N' for none
+ */
+static inline char classify_color(float r, float g, float b) {
+    if (r > RED_THRESHOLD_R && g < RED_THRESHOLD_G && b < RED_THRESHOLD_B) return 'R';
+    if (r < GREEN_THRESHOLD_R && g > GREEN_THRESHOLD_G && b < GREEN_THRESHOLD_B) return 'G';
+    if (r < BLUE_THRESHOLD_R && g < BLUE_THRESHOLD_G && b > BLUE_THRESHOLD_B) return 'B';
+    return 'N';
+}
+
+// ==================== Dispatch ====================
+
+// The scalar kernels compare floats against double constants. The vector
+// paths compare in single precision, so each constant is replaced by the
+// float that gives the same answer for every float input.
+
+// Float f such that (x < f) == ((double)x < t) for all floats x
+static inline float float_threshold_lt(double t) {
+    float f = (float)t;
+    if ((double)f < t) f = nextafterf(f, INFINITY);
+    return f;
+}
+
+// Float f such that (x > f) == ((double)x > t) for all floats x
+static inline float float_threshold_gt(double t) {
+    float f = (float)t;
+    if ((double)f > t) f = nextafterf(f, -INFINITY);
+    return f;
+}
+
+static KernelLevel kernel_level_current = KERNEL_SCALAR;
+static int kernel_level_ready = 0;
+
+/**
+ * @brief Best instruction set supported by the running CPU
+ */
+static inline KernelLevel kernel_level_detect(void) {
+#if SENSOR_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return KERNEL_SSE2;
+#endif
+    return KERNEL_SCALAR;
+}
+
+/**
+ * @brief Forces the batch kernels onto a given path (clamped to what the CPU supports)
+ * @return The level actually selected
+ */
+static inline KernelLevel kernel_level_set(KernelLevel level) {
+    KernelLevel best = kernel_level_detect();
+    kernel_level_current = level > best ? best : level;
+    kernel_level_ready = 1;
+    return kernel_level_current;
+}
+
+/**
+ * @brief Level used by the batch kernels (detected on first use)
+ */
+static inline KernelLevel kernel_level(void) {
+    if (!kernel_level_ready) kernel_level_set(KERNEL_AVX2);
+    return kernel_level_current;
+}
+
+static inline const char* kernel_level_name(KernelLevel level) {
+    switch (level) {
+        case KERNEL_AVX2: return "avx2";
+        case KERNEL_SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+// ==================== SSE2 / AVX2 paths ====================
+// Each returns the number of elements processed; the caller finishes the
+// remainder with the scalar kernel.
+
+#if SENSOR_KERNELS_X86
+
+KERNEL_TARGET("sse2")
+static inline size_t line_centroid_sse2(const SensorBatch* b, float* error) {
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+    const __m128 w0 = _mm_set1_ps(-2.0f), w1 = _mm_set1_ps(-1.0f), w2 = _mm_set1_ps(0.0f);
+    const __m128 w3 = _mm_set1_ps(1.0f), w4 = _mm_set1_ps(2.0f);
+    size_t i = 0;
+    for (; i + 4 <= b->count; i += 4) {
+        __m128 v0 = _mm_sub_ps(one, _mm_loadu_ps(b->ir[0] + i));
+        __m128 v1 = _mm_sub_ps(one, _mm_loadu_ps(b->ir[1] + i));
+        __m128 v2 = _mm_sub_ps(one, _mm_loadu_ps(b->ir[2] + i));
+        __m128 v3 = _mm_sub_ps(one, _mm_loadu_ps(b->ir[3] + i));
+        __m128 v4 = _mm_sub_ps(one, _mm_loadu_ps(b->ir[4] + i));
+        __m128 ws = _mm_add_ps(zero, _mm_mul_ps(w0, v0));
+        ws = _mm_add_ps(ws, _mm_mul_ps(w1, v1));
+        ws = _mm_add_ps(ws, _mm_mul_ps(w2, v2));
+        ws = _mm_add_ps(ws, _mm_mul_ps(w3, v3));
+        ws = _mm_add_ps(ws, _mm_mul_ps(w4, v4));
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(zero, v0), v1), v2), v3), v4);
+        __m128 q = _mm_div_ps(ws, sum);
+        __m128 m = _mm_cmpgt_ps(sum, zero);
+        _mm_storeu_ps(error + i, _mm_and_ps(m, q));
+    }
+    return i;
+}
+
+KERNEL_TARGET("avx2")
+static inline size_t line_centroid_avx2(const SensorBatch* b, float* error) {
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    const __m256 w0 = _mm256_set1_ps(-2.0f), w1 = _mm256_set1_ps(-1.0f), w2 = _mm256_set1_ps(0.0f);
+    const __m256 w3 = _mm256_set1_ps(1.0f), w4 = _mm256_set1_ps(2.0f);
+    size_t i = 0;
+    for (; i + 8 <= b->count; i += 8) {
+        __m256 v0 = _mm256_sub_ps(one, _mm256_loadu_ps(b->ir[0] + i));
+        __m256 v1 = _mm256_sub_ps(one, _mm256_loadu_ps(b->ir[1] + i));
+        __m256 v2 = _mm256_sub_ps(one, _mm256_loadu_ps(b->ir[2] + i));
+        __m256 v3 = _mm256_sub_ps(one, _mm256_loadu_ps(b->ir[3] + i));
+        __m256 v4 = _mm256_sub_ps(one, _mm256_loadu_ps(b->ir[4] + i));
+        __m256 ws = _mm256_add_ps(zero, _mm256_mul_ps(w0, v0));
+        ws = _mm256_add_ps(ws, _mm256_mul_ps(w1, v1));
+        ws = _mm256_add_ps(ws, _mm256_mul_ps(w2, v2));
+        ws = _mm256_add_ps(ws, _mm256_mul_ps(w3, v3));
+        ws = _mm256_add_ps(ws, _mm256_mul_ps(w4, v4));
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(zero, v0), v1), v2), v3), v4);
+        __m256 q = _mm256_div_ps(ws, sum);
+        __m256 m = _mm256_cmp_ps(sum, zero, _CMP_GT_OQ);
+        _mm256_storeu_ps(error + i, _mm256_and_ps(m, q));
+    }
+    return i;
+}
+
+KERNEL_TARGET("sse2")
+static inline size_t pid_step_sse2(const PidGains* g, float* integral, float* prev_error,
+                                   const float* error, float* corr, size_t n) {
+    const __m128 kp = _mm_set1_ps(g->Kp), ki = _mm_set1_ps(g->Ki), kd = _mm_set1_ps(g->Kd);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 e = _mm_loadu_ps(error + i);
+        __m128 in = _mm_add_ps(_mm_loadu_ps(integral + i), e);
+        __m128 d = _mm_sub_ps(e, _mm_loadu_ps(prev_error + i));
+        __m128 c = _mm_add_ps(_mm_add_ps(_mm_mul_ps(kp, e), _mm_mul_ps(ki, in)), _mm_mul_ps(kd, d));
+        _mm_storeu_ps(integral + i, in);
+        _mm_storeu_ps(prev_error + i, e);
+        _mm_storeu_ps(corr + i, c);
+    }
+    return i;
+}
+
+KERNEL_TARGET("avx2")
+static inline size_t pid_step_avx2(const PidGains* g, float* integral, float* prev_error,
+                                   const float* error, float* corr, size_t n) {
+    const __m256 kp = _mm256_set1_ps(g->Kp), ki = _mm256_set1_ps(g->Ki), kd = _mm256_set1_ps(g->Kd);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 e = _mm256_loadu_ps(error + i);
+        __m256 in = _mm256_add_ps(_mm256_loadu_ps(integral + i), e);
+        __m256 d = _mm256_sub_ps(e, _mm256_loadu_ps(prev_error + i));
+        __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(kp, e), _mm256_mul_ps(ki, in)), _mm256_mul_ps(kd, d));
+        _mm256_storeu_ps(integral + i, in);
+        _mm256_storeu_ps(prev_error + i, e);
+        _mm256_storeu_ps(corr + i, c);
+    }
+    return i;
+}
+
+// Line class and node flag in one pass: both need the same comparisons
+KERNEL_TARGET("sse2")
+static inline size_t classify_line_sse2(const SensorBatch* b, uint8_t* cls, uint8_t* node) {
+    const __m128 seen = _mm_set1_ps(float_threshold_lt(LINE_SEEN_THRESHOLD));
+    const __m128 clear = _mm_set1_ps(float_threshold_gt(LINE_CLEAR_THRESHOLD));
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= b->count; i += 4) {
+        __m128 i0 = _mm_loadu_ps(b->ir[0] + i), i1 = _mm_loadu_ps(b->ir[1] + i);
+        __m128 i2 = _mm_loadu_ps(b->ir[2] + i);
+        __m128 i3 = _mm_loadu_ps(b->ir[3] + i), i4 = _mm_loadu_ps(b->ir[4] + i);
+        // Halving is exact, so *0.5f matches the scalar /2.0 rounded to float
+        __m128 le = _mm_mul_ps(_mm_add_ps(i0, i1), half);
+        __m128 re = _mm_mul_ps(_mm_add_ps(i3, i4), half);
+
+        int center = _mm_movemask_ps(_mm_cmplt_ps(i2, seen));
+        int l_seen = _mm_movemask_ps(_mm_cmplt_ps(le, seen));
+        int r_seen = _mm_movemask_ps(_mm_cmplt_ps(re, seen));
+        int l_clear = _mm_movemask_ps(_mm_cmpgt_ps(le, clear));
+        int r_clear = _mm_movemask_ps(_mm_cmpgt_ps(re, clear));
+        int all = _mm_movemask_ps(_mm_and_ps(_mm_and_ps(_mm_and_ps(_mm_cmplt_ps(i0, seen), _mm_cmplt_ps(i1, seen)),
+                                                        _mm_and_ps(_mm_cmplt_ps(i3, seen), _mm_cmplt_ps(i4, seen))),
+                                             _mm_cmplt_ps(i2, seen)));
+
+        for (int k = 0; k < 4; k++) {
+            int bit = 1 << k;
+            cls[i + k] = (center & bit) ? LINE_STRAIGHT
+                       : (l_seen & r_clear & bit) ? LINE_LEFT
+                       : (r_seen & l_clear & bit) ? LINE_RIGHT
+                       : (l_seen & r_seen & bit) ? LINE_INTERSECTION
+                       : LINE_LOST;
+            if (node) node[i + k] = (all & bit) ? 1 : 0;
+        }
+    }
+    return i;
+}
+
+KERNEL_TARGET("avx2")
+static inline size_t classify_line_avx2(const SensorBatch* b, uint8_t* cls, uint8_t* node) {
+    const __m256 seen = _mm256_set1_ps(float_threshold_lt(LINE_SEEN_THRESHOLD));
+    const __m256 clear = _mm256_set1_ps(float_threshold_gt(LINE_CLEAR_THRESHOLD));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 8 <= b->count; i += 8) {
+        __m256 i0 = _mm256_loadu_ps(b->ir[0] + i), i1 = _mm256_loadu_ps(b->ir[1] + i);
+        __m256 i2 = _mm256_loadu_ps(b->ir[2] + i);
+        __m256 i3 = _mm256_loadu_ps(b->ir[3] + i), i4 = _mm256_loadu_ps(b->ir[4] + i);
+        __m256 le = _mm256_mul_ps(_mm256_add_ps(i0, i1), half);
+        __m256 re = _mm256_mul_ps(_mm256_add_ps(i3, i4), half);
+
+        int center = _mm256_movemask_ps(_mm256_cmp_ps(i2, seen, _CMP_LT_OQ));
+        int l_seen = _mm256_movemask_ps(_mm256_cmp_ps(le, seen, _CMP_LT_OQ));
+        int r_seen = _mm256_movemask_ps(_mm256_cmp_ps(re, seen, _CMP_LT_OQ));
+        int l_clear = _mm256_movemask_ps(_mm256_cmp_ps(le, clear, _CMP_GT_OQ));
+        int r_clear = _mm256_movemask_ps(_mm256_cmp_ps(re, clear, _CMP_GT_OQ));
+        __m256 a = _mm256_and_ps(_mm256_cmp_ps(i0, seen, _CMP_LT_OQ), _mm256_cmp_ps(i1, seen, _CMP_LT_OQ));
+        a = _mm256_and_ps(a, _mm256_cmp_ps(i3, seen, _CMP_LT_OQ));
+        a = _mm256_and_ps(a, _mm256_cmp_ps(i4, seen, _CMP_LT_OQ));
+        int all = _mm256_movemask_ps(a) & center;
+
+        for (int k = 0; k < 8; k++) {
+            int bit = 1 << k;
+            cls[i + k] = (center & bit) ? LINE_STRAIGHT
+                       : (l_seen & r_clear & bit) ? LINE_LEFT
+                       : (r_seen & l_clear & bit) ? LINE_RIGHT
+                       : (l_seen & r_seen & bit) ? LINE_INTERSECTION
+                       : LINE_LOST;
+            if (node) node[i + k] = (all & bit) ? 1 : 0;
+        }
+    }
+    return i;
+}
+
+KERNEL_TARGET("sse2")
+static inline size_t classify_color_sse2(const SensorBatch* b, char* color) {
+    const __m128 hi_r = _mm_set1_ps(float_threshold_gt(RED_THRESHOLD_R));
+    const __m128 lo_rg = _mm_set1_ps(float_threshold_lt(RED_THRESHOLD_G));
+    const __m128 lo_rb = _mm_set1_ps(float_threshold_lt(RED_THRESHOLD_B));
+    const __m128 lo_gr = _mm_set1_ps(float_threshold_lt(GREEN_THRESHOLD_R));
+    const __m128 hi_g = _mm_set1_ps(float_threshold_gt(GREEN_THRESHOLD_G));
+    const __m128 lo_gb = _mm_set1_ps(float_threshold_lt(GREEN_THRESHOLD_B));
+    const __m128 lo_br = _mm_set1_ps(float_threshold_lt(BLUE_THRESHOLD_R));
+    const __m128 lo_bg = _mm_set1_ps(float_threshold_lt(BLUE_THRESHOLD_G));
+    const __m128 hi_b = _mm_set1_ps(float_threshold_gt(BLUE_THRESHOLD_B));
+    const __m128 letter_r = _mm_castsi128_ps(_mm_set1_epi32('R'));
+    const __m128 letter_g = _mm_castsi128_ps(_mm_set1_epi32('G'));
+    const __m128 letter_b = _mm_castsi128_ps(_mm_set1_epi32('B'));
+    const __m128 letter_n = _mm_castsi128_ps(_mm_set1_epi32('N'));
+    size_t i = 0;
+    for (; i + 4 <= b->count; i += 4) {
+        __m128 r = _mm_loadu_ps(b->color_r + i), g = _mm_loadu_ps(b->color_g + i), bl = _mm_loadu_ps(b->color_b + i);
+        __m128 red = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(r, hi_r), _mm_cmplt_ps(g, lo_rg)), _mm_cmplt_ps(bl, lo_rb));
+        __m128 green = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(r, lo_gr), _mm_cmpgt_ps(g, hi_g)), _mm_cmplt_ps(bl, lo_gb));
+        __m128 blue = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(r, lo_br), _mm_cmplt_ps(g, lo_bg)), _mm_cmpgt_ps(bl, hi_b));
+        // Select the letter per lane, red first, then narrow the four 32-bit lanes to bytes
+        __m128 c = _mm_or_ps(_mm_and_ps(blue, letter_b), _mm_andnot_ps(blue, letter_n));
+        c = _mm_or_ps(_mm_and_ps(green, letter_g), _mm_andnot_ps(green, c));
+        c = _mm_or_ps(_mm_and_ps(red, letter_r), _mm_andnot_ps(red, c));
+        __m128i w = _mm_packs_epi32(_mm_castps_si128(c), _mm_castps_si128(c));
+        int letters = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+        memcpy(color + i, &letters, 4);
+    }
+    return i;
+}
+
+KERNEL_TARGET("avx2")
+static inline size_t classify_color_avx2(const SensorBatch* b, char* color) {
+    const __m256 hi_r = _mm256_set1_ps(float_threshold_gt(RED_THRESHOLD_R));
+    const __m256 lo_rg = _mm256_set1_ps(float_threshold_lt(RED_THRESHOLD_G));
+    const __m256 lo_rb = _mm256_set1_ps(float_threshold_lt(RED_THRESHOLD_B));
+    const __m256 lo_gr = _mm256_set1_ps(float_threshold_lt(GREEN_THRESHOLD_R));
+    const __m256 hi_g = _mm256_set1_ps(float_threshold_gt(GREEN_THRESHOLD_G));
+    const __m256 lo_gb = _mm256_set1_ps(float_threshold_lt(GREEN_THRESHOLD_B));
+    const __m256 lo_br = _mm256_set1_ps(float_threshold_lt(BLUE_THRESHOLD_R));
+    const __m256 lo_bg = _mm256_set1_ps(float_threshold_lt(BLUE_THRESHOLD_G));
+    const __m256 hi_b = _mm256_set1_ps(float_threshold_gt(BLUE_THRESHOLD_B));
+    const __m256 letter_r = _mm256_castsi256_ps(_mm256_set1_epi32('R'));
+    const __m256 letter_g = _mm256_castsi256_ps(_mm256_set1_epi32('G'));
+    const __m256 letter_b = _mm256_castsi256_ps(_mm256_set1_epi32('B'));
+    const __m256 letter_n = _mm256_castsi256_ps(_mm256_set1_epi32('N'));
+    size_t i = 0;
+    for (; i + 8 <= b->count; i += 8) {
+        __m256 r = _mm256_loadu_ps(b->color_r + i), g = _mm256_loadu_ps(b->color_g + i), bl = _mm256_loadu_ps(b->color_b + i);
+        __m256 red = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r, hi_r, _CMP_GT_OQ), _mm256_cmp_ps(g, lo_rg, _CMP_LT_OQ)),
+                                   _mm256_cmp_ps(bl, lo_rb, _CMP_LT_OQ));
+        __m256 green = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r, lo_gr, _CMP_LT_OQ), _mm256_cmp_ps(g, hi_g, _CMP_GT_OQ)),
+                                     _mm256_cmp_ps(bl, lo_gb, _CMP_LT_OQ));
+        __m256 blue = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r, lo_br, _CMP_LT_OQ), _mm256_cmp_ps(g, lo_bg, _CMP_LT_OQ)),
+                                    _mm256_cmp_ps(bl, hi_b, _CMP_GT_OQ));
+        // Select the letter per lane, red first, then narrow the eight 32-bit lanes to bytes
+        // (packs works within 128-bit halves, so pack the two halves against each other)
+        __m256 c = _mm256_blendv_ps(letter_n, letter_b, blue);
+        c = _mm256_blendv_ps(c, letter_g, green);
+        c = _mm256_blendv_ps(c, letter_r, red);
+        __m256i ci = _mm256_castps_si256(c);
+        __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(ci), _mm256_extracti128_si256(ci, 1));
+        _mm_storel_epi64((__m128i*)(color + i), _mm_packus_epi16(w, w));
+    }
+    return i;
+}
+
+#endif // SENSOR_KERNELS_X86
+
+// ==================== Batch kernels ====================
+
+/**
+ * @brief line_centroid_error() for every element of a batch
+ * @param b Sensor batch (ir channels must be set)
+ * @param error Output array of b->count elements
+ */
+static inline void batch_line_centroid(const SensorBatch* b, float* error) {
+    size_t i = 0;
+#if SENSOR_KERNELS_X86
+    KernelLevel level = kernel_level();
+    if (level == KERNEL_AVX2) i = line_centroid_avx2(b, error);
+    else if (level == KERNEL_SSE2) i = line_centroid_sse2(b, error);
+#endif
+    for (; i < b->count; i++) {
+        float ir[5] = {b->ir[0][i], b->ir[1][i], b->ir[2][i], b->ir[3][i], b->ir[4][i]};
+        error[i] = line_centroid_error(ir);
+    }
+}
+
+/**
+ * @brief pid_step() for n independent controllers sharing the same gains
+ * @param integral Per-controller integral state (updated)
+ * @param prev_error Per-controller previous error (updated)
+ * @param error Current errors
+ * @param corr Output corrections
+ */
+static inline void batch_pid_step(const PidGains* g, float* integral, float* prev_error,
+                                  const float* error, float* corr, size_t n) {
+    size_t i = 0;
+#if SENSOR_KERNELS_X86
+    KernelLevel level = kernel_level();
+    if (level == KERNEL_AVX2) i = pid_step_avx2(g, integral, prev_error, error, corr, n);
+    else if (level == KERNEL_SSE2) i = pid_step_sse2(g, integral, prev_error, error, corr, n);
+#endif
+    for (; i < n; i++) {
+        PidState s = {integral[i], prev_error[i]};
+        corr[i] = pid_step(&s, g, error[i]);
+        integral[i] = s.integral;
+        prev_error[i] = s.prev_error;
+    }
+}
+
+/**
+ * @brief classify_line() and is_node_pattern() for every element of a batch
+ * @param cls Output LineClass values
+ * @param node Output node flags (0/1), may be NULL
+ */
+static inline void batch_classify_line(const SensorBatch* b, uint8_t* cls, uint8_t* node) {
+    size_t i = 0;
+#if SENSOR_KERNELS_X86
+    KernelLevel level = kernel_level();
+    if (level == KERNEL_AVX2) i = classify_line_avx2(b, cls, node);
+    else if (level == KERNEL_SSE2) i = classify_line_sse2(b, cls, node);
+#endif
+    for (; i < b->count; i++) {
+        float ir[5] = {b->ir[0][i], b->ir[1][i], b->ir[2][i], b->ir[3][i], b->ir[4][i]};
+        cls[i] = (uint8_t)classify_line(ir);
+        if (node) node[i] = (uint8_t)is_node_pattern(ir);
+    }
+}
+
+/**
+ * @brief classify_color() for every element of a batch
+ * @param color Output color codes ('R', 'G', 'B', 'N')
+ */
+static inline void batch_classify_color(const SensorBatch* b, char* color) {
+    size_t i = 0;
+#if SENSOR_KERNELS_X86
+    KernelLevel level = kernel_level();
+    if (level == KERNEL_AVX2) i = classify_color_avx2(b, color);
+    else if (level == KERNEL_SSE2) i = classify_color_sse2(b, color);
+#endif
+    for (; i < b->count; i++) {
+        color[i] = classify_color(b->color_r[i], b->color_g[i], b->color_b[i]);
+    }
+}
+
+#endif // SENSOR_KERNELS_H
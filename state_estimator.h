@@ -0,0 +1,255 @@
+#ifndef STATE_ESTIMATOR_H
+#define STATE_ESTIMATOR_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+
+/*
+ * Lightweight state estimator for the line-following controllers.
+ *
+ * Two independent Kalman filters, each predicted from the commanded wheel
+ * speeds and corrected by a sensor:
+ *
+ *   distance  distance to the box ahead (m) and a closing-speed bias (m/s)
+ *             predict: d -= (speed_gain * (left + right) / 2 + bias) * dt
+ *             correct: proximity sensor
+ *   offset    lateral offset of the line, sensor pitch units (+ = line right)
+ *             predict: y -= turn_gain * (left - right) * dt
+ *             correct: line_centroid_error(), skipped while the line is lost
+ *
+ * The bias absorbs the difference between the nominal speed gain and how
+ * fast the box really approaches, so the distance does not lag behind the
+ * sensor. Each filter keeps its covariance, so callers can act on confidence
+ * bounds (estimate +/- k sigma) instead of single raw readings. Proximity
+ * readings outside the innovation gate are rejected as outliers; if
+ * ESTIMATOR_MAX_REJECTS of them arrive in a row the scene really changed (a
+ * box appeared or left) and the filter restarts from the measurement.
+ *
+ * Gains can be overridden from the environment: CB_EST_SPEED_GAIN,
+ * CB_EST_TURN_GAIN, CB_EST_PROXIMITY_NOISE, CB_EST_LINE_NOISE.
+ */
+
+#define ESTIMATOR_SPEED_GAIN 0.5f        // Meters per second per unit of wheel command
+#define ESTIMATOR_TURN_GAIN 2.0f         // Sensor pitches per second per unit of wheel difference
+#define ESTIMATOR_PROXIMITY_NOISE 0.02f  // Proximity reading standard deviation, meters
+#define ESTIMATOR_LINE_NOISE 0.3f        // Line centroid standard deviation, sensor pitches
+#define ESTIMATOR_DISTANCE_Q 0.01f       // Distance process noise, m^2 per second
+#define ESTIMATOR_BIAS_Q 1.0f            // Closing-speed bias process noise, (m/s)^2 per second
+#define ESTIMATOR_BIAS_SIGMA 0.5f        // Closing-speed bias uncertainty after a restart, m/s
+#define ESTIMATOR_OFFSET_Q 4.0f          // Offset process noise, pitch^2 per second
+#define ESTIMATOR_GATE 9.0f              // Innovation gate, squared sigmas (3 sigma)
+#define ESTIMATOR_MAX_REJECTS 3          // Consecutive outliers that restart the filter
+
+// Scalar Kalman filter
+typedef struct {
+    float x;                            // Estimate
+    float p;                            // Variance of the estimate
+    float q;                            // Process noise per second
+    float r;                            // Measurement variance
+    float gate;                         // Innovation gate in squared sigmas (0 = accept everything)
+    bool valid;                         // false until the first measurement
+    int consecutive_rejects;
+    unsigned long updates;
+    unsigned long rejects;
+} Kalman1D;
+
+// Distance with a closing-speed bias: state [d, b], covariance [[p00, p01], [p01, p11]]
+typedef struct {
+    float d, b;
+    float p00, p01, p11;
+    float qd, qb;                       // Process noise per second
+    float r;                            // Measurement variance
+    float gate;                         // Innovation gate in squared sigmas
+    bool valid;
+    int consecutive_rejects;
+    unsigned long updates;
+    unsigned long rejects;
+} DistanceFilter;
+
+typedef struct {
+    DistanceFilter distance;
+    Kalman1D offset;
+    float speed_gain;
+    float turn_gain;
+    unsigned long last_frame;           // frames_received at the last correction
+} StateEstimator;
+
+/**
+ * @brief Initializes a scalar filter with no estimate yet
+ */
+static inline void kalman1d_init(Kalman1D* k, float q, float r, float gate) {
+    memset(k, 0, sizeof(*k));
+    k->q = q;
+    k->r = r;
+    k->gate = gate;
+}
+
+/**
+ * @brief Moves the estimate by dx and grows the variance over dt seconds
+ */
+static inline void kalman1d_predict(Kalman1D* k, float dx, float dt) {
+    if (!k->valid) return;
+    k->x += dx;
+    k->p += k->q * dt;
+}
+
+/**
+ * @brief Corrects the estimate with measurement z
+ * @return 1 if the measurement was used, 0 if it was rejected as an outlier
+ */
+static inline int kalman1d_update(Kalman1D* k, float z) {
+    if (!k->valid) {
+        k->x = z;
+        k->p = k->r;
+        k->valid = true;
+        k->updates++;
+        return 1;
+    }
+
+    float innovation = z - k->x;
+    float s = k->p + k->r;
+    if (k->gate > 0 && innovation * innovation > k->gate * s) {
+        k->rejects++;
+        if (++k->consecutive_rejects < ESTIMATOR_MAX_REJECTS) return 0;
+        // Persistent disagreement: the scene changed, start over from the sensor
+        k->x = z;
+        k->p = k->r;
+        k->consecutive_rejects = 0;
+        k->updates++;
+        return 1;
+    }
+
+    float gain = k->p / s;
+    k->x += gain * innovation;
+    k->p *= 1.0f - gain;
+    k->consecutive_rejects = 0;
+    k->updates++;
+    return 1;
+}
+
+/**
+ * @brief Standard deviation of the estimate
+ */
+static inline float kalman1d_sigma(const Kalman1D* k) {
+    return sqrtf(k->p);
+}
+
+/**
+ * @brief Starts the distance filter over from measurement z with no known bias
+ */
+static inline void distance_filter_reset(DistanceFilter* f, float z) {
+    f->d = z;
+    f->b = 0;
+    f->p00 = f->r;
+    f->p01 = 0;
+    f->p11 = ESTIMATOR_BIAS_SIGMA * ESTIMATOR_BIAS_SIGMA;
+    f->valid = true;
+    f->consecutive_rejects = 0;
+}
+
+/**
+ * @brief Advances the distance over dt seconds at commanded closing speed u (m/s)
+ */
+static inline void distance_filter_predict(DistanceFilter* f, float u, float dt) {
+    if (!f->valid) return;
+    // x = F x - [u dt, 0], F = [[1, -dt], [0, 1]];  P = F P F' + Q
+    f->d -= (u + f->b) * dt;
+    f->p00 += dt * (dt * f->p11 - 2 * f->p01) + f->qd * dt;
+    f->p01 -= dt * f->p11;
+    f->p11 += f->qb * dt;
+}
+
+/**
+ * @brief Corrects the distance with proximity reading z
+ * @return 1 if the reading was used, 0 if it was rejected as an outlier
+ */
+static inline int distance_filter_update(DistanceFilter* f, float z) {
+    if (!f->valid) {
+        distance_filter_reset(f, z);
+        f->updates++;
+        return 1;
+    }
+
+    float innovation = z - f->d;
+    float s = f->p00 + f->r;
+    if (innovation * innovation > f->gate * s) {
+        f->rejects++;
+        if (++f->consecutive_rejects < ESTIMATOR_MAX_REJECTS) return 0;
+        // Persistent disagreement: the scene changed, start over from the sensor
+        distance_filter_reset(f, z);
+        f->updates++;
+        return 1;
+    }
+
+    float k0 = f->p00 / s;
+    float k1 = f->p01 / s;
+    f->d += k0 * innovation;
+    f->b += k1 * innovation;
+    f->p11 -= k1 * f->p01;
+    f->p01 *= 1.0f - k0;
+    f->p00 *= 1.0f - k0;
+    f->consecutive_rejects = 0;
+    f->updates++;
+    return 1;
+}
+
+/**
+ * @brief Standard deviation of the distance estimate
+ */
+static inline float distance_filter_sigma(const DistanceFilter* f) {
+    return sqrtf(f->p00);
+}
+
+/**
+ * @brief Initializes both filters with the default gains and CB_EST_* overrides
+ */
+static inline void estimator_init(StateEstimator* e) {
+    memset(e, 0, sizeof(*e));
+    float proximity_noise = ESTIMATOR_PROXIMITY_NOISE;
+    float line_noise = ESTIMATOR_LINE_NOISE;
+    const char* v;
+
+    e->speed_gain = ESTIMATOR_SPEED_GAIN;
+    e->turn_gain = ESTIMATOR_TURN_GAIN;
+    if ((v = getenv("CB_EST_SPEED_GAIN")) != NULL) e->speed_gain = (float)atof(v);
+    if ((v = getenv("CB_EST_TURN_GAIN")) != NULL) e->turn_gain = (float)atof(v);
+    if ((v = getenv("CB_EST_PROXIMITY_NOISE")) != NULL && atof(v) > 0) proximity_noise = (float)atof(v);
+    if ((v = getenv("CB_EST_LINE_NOISE")) != NULL && atof(v) > 0) line_noise = (float)atof(v);
+
+    e->distance.qd = ESTIMATOR_DISTANCE_Q;
+    e->distance.qb = ESTIMATOR_BIAS_Q;
+    e->distance.r = proximity_noise * proximity_noise;
+    e->distance.gate = ESTIMATOR_GATE;
+    kalman1d_init(&e->offset, ESTIMATOR_OFFSET_Q, line_noise * line_noise, 0);
+}
+
+/**
+ * @brief Predicts both filters from the wheel commands applied over the last dt seconds
+ */
+static inline void estimator_predict(StateEstimator* e, float left, float right, float dt) {
+    distance_filter_predict(&e->distance, e->speed_gain * 0.5f * (left + right), dt);
+    kalman1d_predict(&e->offset, -e->turn_gain * (left - right) * dt, dt);
+}
+
+/**
+ * @brief Corrects both filters with one sensor frame
+ * @param e Pointer to StateEstimator structure
+ * @param proximity Proximity reading, meters
+ * @param line_seen false while no sensor sees the line; the offset is then only predicted
+ * @param line_error line_centroid_error() of the frame
+ */
+static inline void estimator_correct(StateEstimator* e, float proximity, bool line_seen, float line_error) {
+    distance_filter_update(&e->distance, proximity);
+    if (line_seen) kalman1d_update(&e->offset, line_error);
+}
+
+/**
+ * @brief Estimated speed at which the box is getting closer, m/s, at the given wheel commands
+ */
+static inline float estimator_closing_speed(const StateEstimator* e, float left, float right) {
+    return e->speed_gain * 0.5f * (left + right) + e->distance.b;
+}
+
+#endif // STATE_ESTIMATOR_H
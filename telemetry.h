@@ -0,0 +1,243 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "memory_pool.h"
+
+/*
+ * Struct-of-arrays ring of per-tick control telemetry.
+ *
+ * Every column is a preallocated array of `capacity` elements carved out of a
+ * single arena, so telemetry_record() only performs plain stores. Once the ring
+ * is full the oldest rows are overwritten.
+ *
+ * Export file layout (".cbt", host byte order, little-endian on x86/ARM):
+ *
+ *   offset 0    TelemetryFileHeader   (32 bytes)
+ *   offset 32   TelemetryColumnDesc[column_count]   (40 bytes each)
+ *   ...         column data; each column starts at a 64-byte aligned offset
+ *               and holds row_count elements, oldest row first
+ *
+ * A reader can mmap the file and point straight at each column, e.g. with numpy:
+ *   np.frombuffer(buf, dtype=np.float32, count=rows, offset=desc.offset)
+ */
+
+#define TELEMETRY_DEFAULT_CAPACITY 65536
+#define TELEMETRY_MAGIC "CBTELEM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_COLUMN_ALIGN 64
+#define TELEMETRY_NAME_LENGTH 24
+
+// Column element types stored in TelemetryColumnDesc.type
+#define TELEMETRY_TYPE_F64 1
+#define TELEMETRY_TYPE_F32 2
+#define TELEMETRY_TYPE_I32 3
+
+#define TELEMETRY_COLUMN_COUNT 17
+
+// One control tick, as handed to telemetry_record()
+typedef struct {
+    double timestamp;                   // Seconds (monotonic clock)
+    int32_t state;                      // Controller state enum value
+    float ir[5];                        // left_corner, left, middle, right, right_corner
+    float proximity;                    // Proximity distance in meters
+    float color_r, color_g, color_b;    // RGB reading
+    float pid_error;                    // Line position error
+    float pid_p, pid_i, pid_d;          // PID terms (already multiplied by gains)
+    float left, right;                  // Commanded wheel speeds
+} TelemetrySample;
+
+typedef struct {
+    Arena arena;                        // Single block backing all columns
+    size_t capacity;                    // Rows in the ring
+    size_t head;                        // Next row to write
+    size_t count;                       // Valid rows (<= capacity)
+    uint64_t total_recorded;            // Rows ever recorded, including overwritten ones
+
+    double* timestamp;
+    int32_t* state;
+    float* ir[5];
+    float* proximity;
+    float* color_r;
+    float* color_g;
+    float* color_b;
+    float* pid_error;
+    float* pid_p;
+    float* pid_i;
+    float* pid_d;
+    float* left;
+    float* right;
+} TelemetryStore;
+
+typedef struct {
+    char magic[8];                      // TELEMETRY_MAGIC, null-terminated
+    uint32_t version;                   // TELEMETRY_VERSION
+    uint32_t column_count;
+    uint64_t row_count;
+    uint64_t first_row;                 // Index of the oldest row since recording started
+} TelemetryFileHeader;
+
+typedef struct {
+    char name[TELEMETRY_NAME_LENGTH];   // Null-terminated column name
+    uint32_t type;                      // TELEMETRY_TYPE_*
+    uint32_t elem_size;                 // Bytes per element
+    uint64_t offset;                    // Byte offset of the column data in the file
+} TelemetryColumnDesc;
+
+// In-memory view of one column, used by the exporter
+typedef struct {
+    const char* name;
+    uint32_t type;
+    uint32_t elem_size;
+    const void* data;
+} TelemetryColumn;
+
+/**
+ * @brief Allocates all columns of the ring
+ * @param t Pointer to TelemetryStore structure
+ * @param capacity Number of rows to keep
+ * @return 1 on success, 0 if the allocation failed
+ */
+static inline int telemetry_init(TelemetryStore* t, size_t capacity) {
+    memset(t, 0, sizeof(*t));
+    if (capacity == 0) return 0;
+
+    size_t f32 = POOL_ALIGN_UP(capacity * sizeof(float));
+    size_t bytes = POOL_ALIGN_UP(capacity * sizeof(double)) + POOL_ALIGN_UP(capacity * sizeof(int32_t)) +
+                   (TELEMETRY_COLUMN_COUNT - 2) * f32;
+    if (!arena_init(&t->arena, bytes)) return 0;
+
+    t->capacity = capacity;
+    t->timestamp = (double*)arena_alloc(&t->arena, capacity * sizeof(double));
+    t->state = (int32_t*)arena_alloc(&t->arena, capacity * sizeof(int32_t));
+    for (int i = 0; i < 5; i++) t->ir[i] = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->proximity = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->color_r = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->color_g = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->color_b = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->pid_error = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->pid_p = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->pid_i = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->pid_d = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->left = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    t->right = (float*)arena_alloc(&t->arena, capacity * sizeof(float));
+    return 1;
+}
+
+/**
+ * @brief Releases the column storage
+ */
+static inline void telemetry_destroy(TelemetryStore* t) {
+    arena_destroy(&t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+/**
+ * @brief Appends one tick to the ring, overwriting the oldest row when full
+ */
+static inline void telemetry_record(TelemetryStore* t, const TelemetrySample* s) {
+    if (t->capacity == 0) return;
+
+    size_t i = t->head;
+    t->timestamp[i] = s->timestamp;
+    t->state[i] = s->state;
+    for (int k = 0; k < 5; k++) t->ir[k][i] = s->ir[k];
+    t->proximity[i] = s->proximity;
+    t->color_r[i] = s->color_r;
+    t->color_g[i] = s->color_g;
+    t->color_b[i] = s->color_b;
+    t->pid_error[i] = s->pid_error;
+    t->pid_p[i] = s->pid_p;
+    t->pid_i[i] = s->pid_i;
+    t->pid_d[i] = s->pid_d;
+    t->left[i] = s->left;
+    t->right[i] = s->right;
+
+    t->head = (i + 1 == t->capacity) ? 0 : i + 1;
+    if (t->count < t->capacity) t->count++;
+    t->total_recorded++;
+}
+
+/**
+ * @brief Fills the column table in file order
+ * @return Number of columns written to cols
+ */
+static inline int telemetry_columns(const TelemetryStore* t, TelemetryColumn cols[TELEMETRY_COLUMN_COUNT]) {
+    static const char* ir_names[5] = {"ir_left_corner", "ir_left", "ir_middle", "ir_right", "ir_right_corner"};
+    int n = 0;
+
+    cols[n].name = "timestamp"; cols[n].type = TELEMETRY_TYPE_F64; cols[n].elem_size = 8; cols[n++].data = t->timestamp;
+    cols[n].name = "state"; cols[n].type = TELEMETRY_TYPE_I32; cols[n].elem_size = 4; cols[n++].data = t->state;
+    for (int k = 0; k < 5; k++) {
+        cols[n].name = ir_names[k]; cols[n].type = TELEMETRY_TYPE_F32; cols[n].elem_size = 4; cols[n++].data = t->ir[k];
+    }
+
+    const char* f32_names[] = {"proximity", "color_r", "color_g", "color_b", "pid_error",
+                               "pid_p", "pid_i", "pid_d", "left", "right"};
+    const float* f32_data[] = {t->proximity, t->color_r, t->color_g, t->color_b, t->pid_error,
+                               t->pid_p, t->pid_i, t->pid_d, t->left, t->right};
+    for (int k = 0; k < 10; k++) {
+        cols[n].name = f32_names[k]; cols[n].type = TELEMETRY_TYPE_F32; cols[n].elem_size = 4; cols[n++].data = f32_data[k];
+    }
+    return n;
+}
+
+/**
+ * @brief Writes the ring to a columnar binary file (layout described above)
+ * @param t Pointer to TelemetryStore structure
+ * @param path Output file path
+ * @return 1 on success, 0 on I/O error
+ */
+static inline int telemetry_export(const TelemetryStore* t, const char* path) {
+    TelemetryColumn cols[TELEMETRY_COLUMN_COUNT];
+    int ncols = telemetry_columns(t, cols);
+
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return 0;
+
+    TelemetryFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    hdr.version = TELEMETRY_VERSION;
+    hdr.column_count = (uint32_t)ncols;
+    hdr.row_count = t->count;
+    hdr.first_row = t->total_recorded - t->count;
+
+    // Lay out column offsets after the descriptor table
+    TelemetryColumnDesc descs[TELEMETRY_COLUMN_COUNT];
+    uint64_t offset = sizeof(hdr) + ncols * sizeof(TelemetryColumnDesc);
+    for (int k = 0; k < ncols; k++) {
+        memset(&descs[k], 0, sizeof(descs[k]));
+        strncpy(descs[k].name, cols[k].name, TELEMETRY_NAME_LENGTH - 1);
+        descs[k].type = cols[k].type;
+        descs[k].elem_size = cols[k].elem_size;
+        offset = (offset + TELEMETRY_COLUMN_ALIGN - 1) & ~(uint64_t)(TELEMETRY_COLUMN_ALIGN - 1);
+        descs[k].offset = offset;
+        offset += (uint64_t)t->count * cols[k].elem_size;
+    }
+
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             fwrite(descs, sizeof(TelemetryColumnDesc), ncols, fp) == (size_t)ncols;
+
+    // Oldest row is at head once the ring has wrapped, otherwise at 0
+    size_t start = (t->count == t->capacity) ? t->head : 0;
+    size_t first_len = t->count < t->capacity - start ? t->count : t->capacity - start;
+    static const unsigned char zeros[TELEMETRY_COLUMN_ALIGN] = {0};
+
+    for (int k = 0; ok && k < ncols; k++) {
+        long pad = (long)descs[k].offset - ftell(fp);
+        if (pad > 0) ok = fwrite(zeros, 1, (size_t)pad, fp) == (size_t)pad;
+
+        const unsigned char* data = (const unsigned char*)cols[k].data;
+        size_t es = cols[k].elem_size;
+        if (ok && first_len) ok = fwrite(data + start * es, es, first_len, fp) == first_len;
+        if (ok && t->count > first_len) ok = fwrite(data, es, t->count - first_len, fp) == t->count - first_len;
+    }
+
+    if (fclose(fp) != 0) ok = 0;
+    return ok;
+}
+
+#endif // TELEMETRY_H
@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Profile-guided build of the controller, trained on a replayed sensor trace.
+#
+#   tools/pgo.sh [TRACE.in] [BUILD_ROOT]
+#
+# 1. Builds an instrumented tree (CB_PGO=GENERATE) and runs bench_replay on
+#    TRACE.in (a CB_RECORDING input recording) or on the synthetic trace.
+# 2. Rebuilds the same tree with the collected profile (CB_PGO=USE). The
+#    profile is tied to object paths, so both steps share one build directory.
+# 3. Builds a plain release tree and replays the trace on both, reporting the
+#    gain in frames/sec and control-step latency.
+#
+# GCC and Clang are supported; Clang profiles are merged with llvm-profdata.
+
+set -e
+
+SOURCE_DIR=$(cd "$(dirname "$0")/.." && pwd)
+TRACE=${1:-}
+BUILD_ROOT=${2:-$SOURCE_DIR/build-pgo}
+PROFILE_DIR=$BUILD_ROOT/profiles
+JOBS=$(nproc 2>/dev/null || echo 4)
+
+if [ -n "$TRACE" ]; then
+    REPLAY_ARGS="--trace $TRACE"
+else
+    REPLAY_ARGS="--synthetic 50000"
+fi
+
+build() {
+    dir=$1
+    shift
+    cmake -S "$SOURCE_DIR" -B "$dir" -DCMAKE_BUILD_TYPE=Release -DCB_BUILD_BENCHMARKS=ON "$@" >/dev/null
+    cmake --build "$dir" --clean-first -j"$JOBS" >/dev/null
+}
+
+echo "== Instrumented build"
+rm -rf "$PROFILE_DIR"
+build "$BUILD_ROOT/pgo" -DCB_PGO=GENERATE -DCB_PGO_DIR="$PROFILE_DIR"
+
+echo "== Training run ($REPLAY_ARGS)"
+"$BUILD_ROOT/pgo/bench_replay" $REPLAY_ARGS --passes 1 >/dev/null
+
+if ls "$PROFILE_DIR"/*.profraw >/dev/null 2>&1; then
+    llvm-profdata merge -output="$PROFILE_DIR/default.profdata" "$PROFILE_DIR"/*.profraw
+fi
+
+echo "== Optimised build"
+build "$BUILD_ROOT/pgo" -DCB_PGO=USE -DCB_PGO_DIR="$PROFILE_DIR"
+
+echo "== Baseline build"
+build "$BUILD_ROOT/baseline" -DCB_PGO=OFF
+
+echo "== Replay"
+"$BUILD_ROOT/baseline/bench_replay" $REPLAY_ARGS --passes 5 --json "$BUILD_ROOT/baseline.json" >/dev/null
+"$BUILD_ROOT/pgo/bench_replay" $REPLAY_ARGS --passes 5 --json "$BUILD_ROOT/pgo.json" >/dev/null
+
+field() {
+    sed -n "s/.*\"$2\": \([0-9.]*\).*/\1/p" "$1"
+}
+
+report() {
+    base=$(field "$BUILD_ROOT/baseline.json" "$1")
+    pgo=$(field "$BUILD_ROOT/pgo.json" "$1")
+    awk -v name="$2" -v b="$base" -v p="$pgo" -v higher="$3" 'BEGIN {
+        gain = higher ? (p / b - 1) * 100 : (1 - p / b) * 100
+        printf "  %-20s %14.1f %14.1f %+9.1f%%\n", name, b, p, gain
+    }'
+}
+
+printf "\n  %-20s %14s %14s %10s\n" "" "baseline" "pgo" "gain"
+report frames_per_sec "frames/sec" 1
+report step_p50_ns "step p50 (ns)" 0
+report step_p99_ns "step p99 (ns)" 0
+echo
+echo "Results: $BUILD_ROOT/baseline.json, $BUILD_ROOT/pgo.json"
@@ -0,0 +1,113 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Stale-data failsafe. The controller reports the age of the newest sensor
+ * frame every time it wants to move; the watchdog answers with a speed scale:
+ *
+ *   age <= degrade_after           1.0 (full speed)
+ *   degrade_after < age < budget   falls linearly from 1.0 to 0.0
+ *   age >= budget                  0.0 (motors stopped)
+ *
+ * The budget defaults to WATCHDOG_BUDGET_PERIODS expected frame periods.
+ */
+
+#define WATCHDOG_FRAME_PERIOD_MS 50      // Expected time between sensor frames
+#define WATCHDOG_BUDGET_PERIODS 3.0      // Stop after this many periods without a frame
+#define WATCHDOG_DEGRADE_PERIODS 1.5     // Start slowing down after this many periods
+
+typedef enum {
+    WATCHDOG_OK,
+    WATCHDOG_DEGRADED,
+    WATCHDOG_STOPPED
+} WatchdogState;
+
+typedef struct {
+    double expected_period;             // Seconds between frames
+    double degrade_after;               // Frame age at which slowing down starts
+    double budget;                      // Frame age at which the motors are stopped
+    WatchdogState state;
+
+    // Counters
+    unsigned long checks;
+    unsigned long degraded_checks;      // Checks answered with 0 < scale < 1
+    unsigned long stopped_checks;       // Checks answered with scale 0
+    unsigned int degrade_events;        // OK -> DEGRADED transitions
+    unsigned int stop_events;           // Transitions into STOPPED
+    double max_age;                     // Oldest frame age seen
+} Watchdog;
+
+/**
+ * @brief Configures the watchdog
+ * @param w Pointer to Watchdog structure
+ * @param expected_period_ms Expected time between sensor frames
+ * @param budget_ms Frame age at which the motors are stopped (0 = default multiple of the period)
+ */
+static inline void watchdog_init(Watchdog* w, double expected_period_ms, double budget_ms) {
+    w->expected_period = expected_period_ms / 1000.0;
+    w->budget = budget_ms > 0 ? budget_ms / 1000.0 : w->expected_period * WATCHDOG_BUDGET_PERIODS;
+    w->degrade_after = w->expected_period * WATCHDOG_DEGRADE_PERIODS;
+    if (w->degrade_after > w->budget) w->degrade_after = w->budget;
+    w->state = WATCHDOG_OK;
+    w->checks = 0;
+    w->degraded_checks = 0;
+    w->stopped_checks = 0;
+    w->degrade_events = 0;
+    w->stop_events = 0;
+    w->max_age = 0;
+}
+
+/**
+ * @brief Configures the watchdog from CB_FRAME_PERIOD_MS / CB_LATENCY_BUDGET_MS, falling back to defaults
+ */
+static inline void watchdog_init_from_env(Watchdog* w) {
+    const char* period = getenv("CB_FRAME_PERIOD_MS");
+    const char* budget = getenv("CB_LATENCY_BUDGET_MS");
+    double period_ms = period ? atof(period) : 0;
+    watchdog_init(w, period_ms > 0 ? period_ms : WATCHDOG_FRAME_PERIOD_MS, budget ? atof(budget) : 0);
+}
+
+/**
+ * @brief Speed scale for a given frame age; updates state and counters
+ * @param w Pointer to Watchdog structure
+ * @param frame_age Seconds since the newest sensor frame arrived
+ * @return Factor in [0, 1] to apply to wheel speeds
+ */
+static inline float watchdog_update(Watchdog* w, double frame_age) {
+    float scale;
+    WatchdogState next;
+
+    if (frame_age <= w->degrade_after) {
+        scale = 1.0f;
+        next = WATCHDOG_OK;
+    } else if (frame_age < w->budget) {
+        scale = (float)((w->budget - frame_age) / (w->budget - w->degrade_after));
+        next = WATCHDOG_DEGRADED;
+    } else {
+        scale = 0.0f;
+        next = WATCHDOG_STOPPED;
+    }
+
+    w->checks++;
+    if (frame_age > w->max_age) w->max_age = frame_age;
+    if (next == WATCHDOG_DEGRADED) w->degraded_checks++;
+    if (next == WATCHDOG_STOPPED) w->stopped_checks++;
+
+    if (next != w->state) {
+        if (next == WATCHDOG_STOPPED) {
+            w->stop_events++;
+            printf("Watchdog: no sensor data for %.0f ms, stopping motors\n", frame_age * 1000.0);
+        } else if (next == WATCHDOG_DEGRADED && w->state == WATCHDOG_OK) {
+            w->degrade_events++;
+        } else if (next == WATCHDOG_OK && w->state == WATCHDOG_STOPPED) {
+            printf("Watchdog: sensor data fresh again, resuming\n");
+        }
+        w->state = next;
+    }
+    return scale;
+}
+
+#endif // WATCHDOG_H
@@ -0,0 +1,116 @@
+#ifndef WHEEL_SHAPING_H
+#define WHEEL_SHAPING_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+
+/*
+ * Differential-drive output shaping.
+ *
+ * Clamping each wheel to its range on its own throws the steering away as
+ * soon as the base speed saturates: base + corr and base - corr both clip to
+ * the maximum and the robot drives straight. The shaper treats the command as
+ * a common mode (mean of the wheels) and a difference (left - right):
+ *
+ *   1. the difference is kept as is, or clipped to the width of the range if
+ *      even that cannot be reached
+ *   2. the common mode gives way, so both wheels fit in the range with the
+ *      difference intact
+ *   3. both are slew limited against the command sent on the previous tick,
+ *      then step 2 is applied again
+ *
+ * Counters say how often the command saturated, how often the difference
+ * itself had to be clipped and how often the slew limit was active.
+ */
+
+typedef struct {
+    float min_out, max_out;             // Wheel command range
+    float slew;                         // Command units per second, common mode and half difference (0 = off)
+
+    // Counters
+    unsigned long commands;
+    unsigned long saturated;            // Common mode lowered (or raised) to fit the range
+    unsigned long clipped;              // Difference wider than the range, steering reduced
+    unsigned long slew_limited;
+} WheelShaper;
+
+/**
+ * @brief Sets the wheel range and slew limit
+ */
+static inline void wheel_shaper_init(WheelShaper* w, float min_out, float max_out, float slew) {
+    memset(w, 0, sizeof(*w));
+    w->min_out = min_out;
+    w->max_out = max_out;
+    w->slew = slew;
+}
+
+/**
+ * @brief Common mode closest to mean that keeps both wheels in range with this difference
+ */
+static inline float wheel_shaper_fit(const WheelShaper* w, float mean, float diff) {
+    float half = 0.5f * fabsf(diff);
+    if (mean > w->max_out - half) mean = w->max_out - half;
+    if (mean < w->min_out + half) mean = w->min_out + half;
+    return mean;
+}
+
+/**
+ * @brief Shapes one wheel command in place
+ * @param w Pointer to WheelShaper structure
+ * @param left Wanted left command, replaced by the shaped one
+ * @param right Wanted right command, replaced by the shaped one
+ * @param prev_left Left command sent on the previous tick
+ * @param prev_right Right command sent on the previous tick
+ * @param dt Seconds since the previous tick
+ */
+static inline void wheel_shaper_apply(WheelShaper* w, float* left, float* right,
+                                      float prev_left, float prev_right, float dt) {
+    float mean = 0.5f * (*left + *right);
+    float diff = *left - *right;
+    float width = w->max_out - w->min_out;
+    w->commands++;
+
+    if (diff > width || diff < -width) {
+        diff = diff > 0 ? width : -width;
+        w->clipped++;
+    }
+    float fitted = wheel_shaper_fit(w, mean, diff);
+    if (fitted != mean) w->saturated++;
+    mean = fitted;
+
+    if (w->slew > 0 && dt > 0) {
+        // Limiting the common mode and the difference separately keeps the turn
+        // consistent while the robot speeds up or slows down
+        float step = w->slew * dt;
+        float prev_mean = 0.5f * (prev_left + prev_right);
+        float prev_diff = prev_left - prev_right;
+        bool limited = false;
+        if (mean > prev_mean + step) { mean = prev_mean + step; limited = true; }
+        if (mean < prev_mean - step) { mean = prev_mean - step; limited = true; }
+        if (diff > prev_diff + 2 * step) { diff = prev_diff + 2 * step; limited = true; }
+        if (diff < prev_diff - 2 * step) { diff = prev_diff - 2 * step; limited = true; }
+        if (limited) {
+            w->slew_limited++;
+            if (diff > width) diff = width;
+            if (diff < -width) diff = -width;
+            mean = wheel_shaper_fit(w, mean, diff);
+        }
+    }
+
+    *left = mean + 0.5f * diff;
+    *right = mean - 0.5f * diff;
+}
+
+/**
+ * @brief Prints how often the command saturated, was clipped or slew limited
+ */
+static inline void wheel_shaper_report(const WheelShaper* w, const char* name) {
+    if (w->commands == 0) return;
+    printf("%s: %lu commands, %.0f%% saturated, %.0f%% steering clipped, %.0f%% slew limited\n", name,
+           w->commands, 100.0 * w->saturated / w->commands, 100.0 * w->clipped / w->commands,
+           100.0 * w->slew_limited / w->commands);
+}
+
+#endif // WHEEL_SHAPING_H